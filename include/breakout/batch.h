@@ -0,0 +1,76 @@
+#pragma once
+
+#include "breakout/simulation.h"
+#include "breakout/controller.h"
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace Game {
+
+	struct BatchConfig {
+		int instances = 1000;
+		int threads = 0;						//0 = one per hardware thread
+		float tickRate = 240.f;
+		uint32_t maxTicks = 240 * 60 * 10;		//per instance (game is cut off afterwards)
+		uint32_t seed = 1;						//instance i uses seed + i
+		int stressBalls = 0;					//extra balls launched with the first ball of each round
+		bool autoplay = false;					//AutoPlayer instead of random inputs
+		std::vector<std::string> levels;		//instance i plays levels[i % levels.size()]
+	};
+
+	enum class BatchOutcome { Won, Lost, TimedOut };
+
+	struct BatchResult {
+		int level = 0;
+		uint32_t seed = 0;
+		BatchOutcome outcome = BatchOutcome::TimedOut;
+		uint32_t ticks = 0;
+		int livesLeft = 0;
+		int bricksDestroyed = 0;
+		int maxBalls = 0;
+	};
+
+	//Single headless game - simulation driven by a controller (random inputs with its own RNG, or the autoplayer).
+	//Plays one level, until it's cleared, all the lives are lost or it runs out of ticks.
+	class BatchInstance {
+	public:
+		BatchInstance(uint32_t seed, int level, const std::string& levelDesc, int stressBalls, bool autoplay);
+
+		//Steps the game to its end. Returns the number of simulated ticks.
+		uint32_t Run(float tickDelta, uint32_t maxTicks);
+
+		const BatchResult& Result() const { return result; }
+	private:
+		Simulation sim;
+		IControllerRef controller;
+		BatchResult result;
+
+		int stressBalls;
+	};
+
+	//Runs many independent games in parallel (thread pool) & reports throughput and outcomes.
+	class BatchRunner {
+	public:
+		BatchRunner(const BatchConfig& config);
+
+		//Simulates all the instances. Returns false if the configuration is invalid (no levels).
+		bool Run();
+
+		//Aggregate statistics to stderr (per-instance outcomes as well, if requested).
+		void Report(bool perInstance) const;
+
+		const std::vector<BatchResult>& Results() const { return results; }
+	private:
+		BatchConfig config;
+		std::vector<BatchResult> results;
+
+		int threadCount = 0;
+		double wallTime_s = 0.0;
+		std::vector<double> busyTime_s;		//per worker thread
+	};
+
+	const char* BatchOutcomeName(BatchOutcome outcome);
+
+}//namespace Game
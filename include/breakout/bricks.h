@@ -0,0 +1,109 @@
+#pragma once
+
+#include "breakout/glm.h"
+
+#include <vector>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Game {
+
+	namespace BrickType {
+		enum {
+			Brick = 0,
+			Wall,
+			PlatformGrow,
+			PlatformShrink,
+			PlatformSticking,
+			WallBreaker,
+			BallSpeedUp,
+			BallSlowDown,
+			EffectBlur,
+			EffectDrunk,
+			EffectChaos,
+			EffectConfuse,
+			MultiBall,
+		};
+
+		const char* BrickCodes();
+		glm::ivec2 GetTypeTexCoord(int type, int color);
+	}
+
+	//Index of the lowest set bit (bits must be non-zero).
+	inline int LowestBitIdx(uint64_t bits) {
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanForward64(&idx, bits);
+		return int(idx);
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	//Structure-of-arrays storage of level's bricks.
+	//Destroyed bricks are only marked as dead (tombstones), so brick indices stay valid for the whole level.
+	struct BrickStore {
+		std::vector<int16_t> x;			//grid coords
+		std::vector<int16_t> y;
+		std::vector<uint8_t> type;
+		std::vector<uint8_t> color;
+		std::vector<uint64_t> alive;	//bitmask, 1 bit per brick
+
+		int aliveCount = 0;
+		int bricksLeft = 0;				//alive bricks of BrickType::Brick type (level is finished when there's none left)
+	public:
+		void Clear();
+
+		int Add(int x, int y, int type, int color);
+
+		//Marks the brick as destroyed, updates the counters.
+		void Remove(int idx);
+
+		//Number of slots (including destroyed bricks).
+		int Size() const { return int(type.size()); }
+		int AliveCount() const { return aliveCount; }
+
+		bool IsAlive(int idx) const { return (alive[idx >> 6] >> (idx & 63)) & 1; }
+		glm::ivec2 Coords(int idx) const { return glm::ivec2(x[idx], y[idx]); }
+
+		//Brick's center in NDC coords.
+		glm::vec2 Position(int idx, const glm::vec2& brickSize) const {
+			return glm::vec2(
+				-1.f + x[idx] * brickSize.x * 2.f + brickSize.x,
+				1.f - y[idx] * brickSize.y * 2.f - brickSize.y
+			);
+		}
+
+		//Calls fn(idx) for every alive brick (in the order, in which they were added).
+		template<typename Fn>
+		void ForEachAlive(Fn&& fn) const {
+			for (int w = 0; w < int(alive.size()); w++) {
+				uint64_t bits = alive[w];
+				while (bits != 0) {
+					fn((w << 6) + LowestBitIdx(bits));
+					bits &= bits - 1;
+				}
+			}
+		}
+	};
+
+	//Uniform grid over the playing field (cell = brick slot), used as a broadphase for ball-brick collisions.
+	//Maps brick coords to brick indices, there's at most one brick per cell.
+	struct BrickGrid {
+		std::vector<int> cells;				//brick index or -1 if empty
+		glm::ivec2 size = glm::ivec2(0);
+		glm::vec2 cellSize = glm::vec2(0.f);
+	public:
+		void Build(const BrickStore& bricks, const glm::ivec2& fieldSize, const glm::vec2& brickSize);
+
+		int& At(int x, int y) { return cells[y * size.x + x]; }
+		int& At(const glm::ivec2& coords) { return At(coords.x, coords.y); }
+
+		//Computes range of cells (inclusive) overlapped by given AABB. Returns false if the AABB misses the grid entirely.
+		bool CellRange(const glm::vec2& aabbMin, const glm::vec2& aabbMax, glm::ivec2& out_from, glm::ivec2& out_to) const;
+	};
+
+}//namespace Game
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "breakout/glm.h"
+
+#include <vector>
+
+namespace Game {
+
+	//Candidate bricks for the batched narrow-phase, stored as SoA.
+	//Arrays are padded (with far away dummy bricks) to a multiple of the widest SIMD batch.
+	struct BrickCandidates {
+		std::vector<float> x;			//brick centers
+		std::vector<float> y;
+		std::vector<int> brickIdx;
+		int count = 0;
+	public:
+		void Clear() { count = 0; }
+		void Add(int idx, const glm::vec2& pos);
+
+		//Fills the arrays up to the next multiple of the batch width.
+		void Pad();
+	};
+
+	//Result of the batched ball-brick sweep.
+	struct BrickHit {
+		int brickIdx = -1;
+		float t = 0.f;				//time of impact (fraction of the movement)
+	};
+
+	namespace Collision {
+
+		//Widest batch the kernels process at once (AVX-512).
+		constexpr int maxBatchWidth = 16;
+
+		enum class InstructionSet { Scalar, SSE, AVX2, AVX512 };
+
+		//Instruction set used by the batched kernels. Picked on first use (best one supported by the CPU).
+		InstructionSet ActiveInstructionSet();
+
+		//Overrides kernel selection (not thread-safe, call before running simulations).
+		//Falls back to the best supported set, if the CPU can't do the requested one.
+		void SetInstructionSet(InstructionSet set);
+
+		const char* InstructionSetName(InstructionSet set);
+
+		//Swept circle vs AABB test (continuous collision detection).
+		//Returns false if the circle moving by delta doesn't touch the box, out_t = time of impact as a fraction of delta (0 if already overlapping).
+		bool SweptCircle_AABB(const glm::vec2& pos, const glm::vec2& delta, float radius, const glm::vec2& boxPos, const glm::vec2& boxSize, float& out_t);
+
+		//Contact resolution for a circle touching (or overlapping) the box.
+		//Returns the contact normal, out_posFix moves the circle to (radius + skin) distance from the box.
+		glm::vec2 Circle_AABBContact(const glm::vec2& pos, float radius, const glm::vec2& boxPos, const glm::vec2& boxSize, float skin, glm::vec2& out_posFix);
+
+		//Sweeps the ball against all candidates at once (4/8/16 bricks per instruction, based on the active instruction set).
+		//Picks the earliest hit brick (ties go to the earlier candidate).
+		bool Ball_BricksSweep(const glm::vec2& ballPos, const glm::vec2& delta, float radius, const glm::vec2& brickSize, BrickCandidates& candidates, BrickHit& out_hit);
+
+	}//namespace Collision
+
+}//namespace Game
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "breakout/simulation.h"
+
+#include <memory>
+#include <random>
+#include <stdint.h>
+
+namespace Game {
+
+	class IController;
+	using IControllerRef = std::shared_ptr<IController>;
+
+	//Source of the player's input (instead of the keyboard).
+	class IController {
+	public:
+		virtual ~IController() = default;
+
+		//Decides the input for the next simulation tick. out_launch = launch the balls sitting on the platform.
+		virtual void Update(const Simulation& sim, float deltaTime, SimInput& out_input, bool& out_launch) = 0;
+	};
+
+	//Presses random directions (held for random intervals), launches right away.
+	class RandomController : public IController {
+	public:
+		RandomController(uint32_t seed);
+
+		virtual void Update(const Simulation& sim, float deltaTime, SimInput& out_input, bool& out_launch) override;
+	private:
+		std::mt19937 rng;
+		SimInput input;
+		float inputHold = 0.f;			//time until the next input change
+	};
+
+	//Heuristic player - moves the platform under the predicted landing spot of the ball that comes down first.
+	//Prediction only accounts for the walls (bricks on the way are ignored).
+	class AutoPlayer : public IController {
+	public:
+		AutoPlayer(float launchDelay = 0.f);
+
+		virtual void Update(const Simulation& sim, float deltaTime, SimInput& out_input, bool& out_launch) override;
+
+		//Horizontal position, at which the ball reaches the platform's level (bounces off the side & top walls included).
+		static float PredictLandingX(const Ball& b, float& out_timeToLand);
+	private:
+		float launchDelay;
+		float launchTimer = 0.f;
+	};
+
+}//namespace Game
@@ -16,12 +16,29 @@ public:
 
 	Framebuffer() = default;
 
+	//Reallocates the attachment, viewport is reset to the whole framebuffer.
 	void Resize(int newWidth, int newHeight);
 
+	//Limits rendering to the bottom-left part of the framebuffer (resolution scaling without reallocation). Clamped to the framebuffer's size.
+	void SetViewport(int width, int height);
+
+	//Binds the framebuffer, viewport covers its used part (framebuffer can be smaller than the window).
 	void Bind() const;
+
+	//Binds the default render target (window's framebuffer, or its offscreen replacement in headless mode), viewport covers the whole window.
 	static void Unbind();
 
+	//Offscreen framebuffer, that stands in for the default one (headless mode - there's no window surface). nullptr = window's framebuffer.
+	static void SetBackbuffer(const Framebuffer* fbo);
+
 	TextureRef& GetTexture() { return texture; }
+	const TextureRef& GetTexture() const { return texture; }
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+
+	int ViewportWidth() const { return viewportWidth; }
+	int ViewportHeight() const { return viewportHeight; }
 
 	bool IsComplete() const;
 private:
@@ -30,6 +47,10 @@ private:
 
 	int width;
 	int height;
+	int viewportWidth;
+	int viewportHeight;
 	GLenum internalFormat;
 
+	static GLuint backbuffer;
+
 };
\ No newline at end of file
@@ -1,12 +1,61 @@
 #pragma once
 
 #include "breakout/glm.h"
+#include "breakout/simulation.h"
+
+#include <string>
 
 namespace Game {
 
 	//Initiates the game logic.
 	void Run();
 
+	//Simulation frequency (fixed timestep). Default is 240 Hz.
+	void SetTickRate(float ticksPerSecond);
+
+	//Launches given number of extra balls at the start of each round.
+	void SetStressMode(int ballCount);
+
+	//Directory, from which the levels are loaded (all .txt files). Needs to be called before Run().
+	void SetLevelsDirectory(const std::string& path);
+
+	//Platform driven by the heuristic autoplayer instead of the keyboard (unattended runs).
+	void SetAutoplay(bool enabled);
+
+	//Records the player's inputs (with RNG seed & level list) into given file. The file is written at the end of each game session.
+	void SetRecordingFile(const std::string& filepath);
+
+	//GL calls are recorded into frame packets & replayed by a dedicated render thread (simulation of the next frame overlaps with the submission). Needs to be called before Run().
+	void SetRenderThread(bool enabled);
+
+	//Offscreen GL context without a window (no display needed, e.g. Mesa llvmpipe) - autoplay is enabled, unless a replay is set. Needs to be called before Run().
+	void SetHeadless(bool enabled);
+
+	//Quads are rasterized on the CPU (GL only loads the resources & shows the result) - same pixels on every machine. Needs to be called before Run().
+	void SetSoftwareRenderer(bool enabled);
+
+	//Quits after given number of presented frames (0 = no limit).
+	void SetFrameLimit(int frames);
+
+	//Saves the last frame into given file (binary PPM) at the end of the run.
+	void SetScreenshotFile(const std::string& filepath);
+
+	//Writes the trace zones into given file (Chrome trace-event JSON) at the end of the run. Requires the BREAKOUT_TRACE build.
+	void SetTraceFile(const std::string& filepath);
+
+	//Scene is rendered at 50-100% of the window's resolution (upscaled by the postprocessing pass, GUI stays native), scale follows
+	//the profiled frame cost against given budget. 0 = native resolution only.
+	void SetDynamicResolution(float frameBudget_ms);
+
+	//Renderer's per-pass stats (CPU & GPU times, draw calls, flushes, uploads) drawn over the GUI. Toggled by F3 afterwards.
+	void SetStatsOverlay(bool enabled);
+
+	//Appends the renderer's per-pass stats into given CSV file (a row per pass & frame). Overlay can be toggled by F3.
+	void SetStatsFile(const std::string& filepath);
+
+	//Plays back a recorded session instead of reading the keyboard (overrides tick rate, stress mode & levels). Returns false if the file can't be loaded.
+	bool SetReplayFile(const std::string& filepath);
+
 	void Release();
 
 	//==== Structs ====
@@ -20,55 +69,4 @@ namespace Game {
 		Transition,
 	};
 
-	struct Platform {
-		float pos = 0.f;
-		float scale;
-		float speed;
-	};
-
-	struct Ball {
-		glm::vec2 pos = glm::vec2(0.f);
-		glm::vec2 dir = glm::vec2(0.f, 1.f);
-		float speed;
-		float radius = 0.05f;
-
-		bool onPlatform = true;
-	};
-
-	namespace BrickType {
-		enum {
-			Brick = 0,
-			Wall,
-			PlatformGrow,
-			PlatformShrink,
-			PlatformSticking,
-			WallBreaker,
-			BallSpeedUp,
-			BallSlowDown,
-			EffectBlur,
-			EffectDrunk,
-			EffectChaos,
-			EffectConfuse,
-		};
-
-		const char* BrickCodes();
-		glm::ivec2 GetTypeTexCoord(int type, int color);
-	}
-
-	struct Brick {
-		int type = BrickType::Brick;
-		int color = 1;
-
-		glm::vec2 pos = glm::vec2(0.f);
-		glm::ivec2 coords = glm::ivec2(0);
-
-		glm::ivec2 tc;
-	public:
-		Brick() = default;
-		Brick(int x, int y, int type_, int color_) : coords(glm::ivec2(x, y)), type(type_), color(color_) {
-			tc = BrickType::GetTypeTexCoord(type, color);
-		}
-		//Brick(int x, int y, char c) : coords(glm::ivec2(x, y)), type(int(c)), brickType(1) {}
-	};
-
 }//namespace Game
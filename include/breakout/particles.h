@@ -18,6 +18,11 @@ struct Particle {
 	float startingLife = 0.f;		//for color lerping purposes
 
 	glm::vec4 color;
+
+	//state from previous update (for render interpolation)
+	glm::vec2 prevPosition = glm::vec2(0.f);
+	float prevAngle_rad = 0.f;
+	float prevScale = 1.f;
 };
 
 class ParticleSystem {
@@ -27,8 +32,11 @@ public:
 	ParticleSystem(ParticleUpdateFn ParticleUpdate, int maxCount = 10);
 	ParticleSystem() = default;
 
+	//Particles state gets snapshotted before the update, newly spawned particles should set their prev* values themselves.
 	void Update(float deltaTime);
-	void Render();
+
+	//alpha = interpolation factor between the previous and the current update.
+	void Render(float alpha = 1.f);
 
 	void Reset();
 private:
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "breakout/renderer.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Frame pacing statistics (sums over the presented frames).
+struct FrameTimings {
+	int frames = 0;
+	double latency_s = 0.0;			//frame start (input sampling) -> buffers swapped
+};
+
+//Owns the GL context & replays the recorded frames on its own thread (double-buffered frame packets).
+//The game thread records frame N+1, while frame N is being submitted to the driver (and waits for vsync).
+class RenderThread {
+public:
+	//Takes over the window's GL context (has to be current on the calling thread) & starts recording the first frame.
+	RenderThread();
+
+	//Finishes the submitted frame, executes the calls recorded since & hands the context back to the calling thread.
+	~RenderThread();
+
+	//copy disabled
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	//Hands the recorded frame over (waits, if the previous one isn't presented yet) & starts recording the next one.
+	//frameStart = time of the frame's input sampling (glfwGetTime()), for the latency measurement.
+	void SubmitFrame(double frameStart);
+
+	FrameTimings Timings();
+private:
+	void Loop();
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	Renderer::FramePacketRef packets[2];
+	int recordIdx = 0;				//packet that's being recorded (the other one belongs to the render thread)
+	bool pending = false;			//submitted packet isn't presented yet
+	bool quit = false;
+	double frameStart = 0.0;		//of the submitted packet
+
+	FrameTimings timings;
+};
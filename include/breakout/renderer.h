@@ -5,52 +5,170 @@
 #include "breakout/texture.h"
 #include "breakout/text.h"
 #include "breakout/framebuffer.h"
+#include "breakout/soft_raster.h"
 
-struct Vertex {
-	glm::vec3 position;
-	glm::vec4 color;
-	glm::vec2 texCoords;
-	glm::vec2 texTiling;
-	float textureID;
-	float alphaTexture;
-public:
-	Vertex() = default;
-	Vertex(const glm::vec3& position, const glm::vec4& color, const glm::vec2& texCoords, float textureID);
-};
+#include <vector>
+#include <string>
+#include <functional>
 
+//Single quad, as sent to the GPU (one instance - corners are generated in the vertex shader).
 struct Quad {
-	Vertex vertices[4];
+	glm::vec3 center;
+	glm::vec2 halfSize;
+	float angle_rad = 0.f;
+	glm::vec4 texRect;				//texture coords of the bottom-left (xy) & top-right (zw) corners
+	uint64_t textureHandle;			//bindless texture handle (GL texture name with the software backend or texture slots), 0 = no texture - filled in by the renderer on submission
+	uint32_t color;					//RGBA8
+	float alphaTexture = 0.f;		//texture only provides alpha channel (text)
 public:
 	Quad() = default;
 
 	//color only quad
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color);
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color, float angle_rad);
+	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color, float angle_rad = 0.f);
 
 	//texture only quad
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, float textureID, const ITextureRef& texture);
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, float textureID, const ITextureRef& texture, float angle_rad);
+	Quad(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture, float angle_rad = 0.f);
 
 	//both
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& colorTint, float textureID, const ITextureRef& texture);
-	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& colorTint, float textureID, const ITextureRef& texture, float angle_rad);
+	Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& colorTint, const ITextureRef& texture, float angle_rad = 0.f);
 
-	Quad(const CharInfo& charInfo, const glm::vec2& topLeft, float scale, const glm::vec4& color, float textureID, const glm::vec2& _1_atlSize, const glm::vec2& _1_winSize);
-};
+	Quad(const CharInfo& charInfo, const glm::vec2& topLeft, float scale, const glm::vec4& color, const glm::vec2& _1_atlSize, const glm::vec2& _1_winSize);
 
-struct QuadIndices {
-	uint32_t indices[5];
-public:
-	QuadIndices() = default;
-	QuadIndices(int idx);
+	//Corner position (0 = bottom-left, 1 = top-left, 2 = bottom-right, 3 = top-right).
+	glm::vec2 Corner(int i) const;
 };
 
+//(inline - shared by the renderer & the software rasterizer)
+inline glm::vec2 Quad::Corner(int i) const {
+	glm::vec2 local = glm::vec2((i & 2) ? 1.f : -1.f, (i & 1) ? 1.f : -1.f) * halfSize;
+	if (angle_rad != 0.f) {
+		float c = cosf(angle_rad);
+		float s = sinf(angle_rad);
+		local = glm::vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+	}
+	return glm::vec2(center) + local;
+}
+
 namespace Renderer {
 
+	class QuadLayer;
+	using QuadLayerRef = std::shared_ptr<QuadLayer>;
+
+	struct FramePacket;
+	using FramePacketRef = std::shared_ptr<FramePacket>;
+
+	struct LayerUpdate;
+	struct LayerDraw;
+
+	enum class Backend {
+		OpenGL,
+		Software,		//batches are rasterized on the CPU (SoftRaster), GL only holds the resources & shows the result
+	};
+
+	//Reasons for a batch flush (index into RendererStats::flushes).
+	enum FlushCause {
+		Flush_BatchFull,				//batch reached its capacity
+		Flush_Shader,					//shader switch
+		Flush_Order,					//retained layer draw (quads queued before it have to be drawn first)
+		Flush_Textures,					//texture slots ran out (GL backend without bindless textures)
+		Flush_Explicit,					//End() or Flush() call
+		Flush_COUNT
+	};
+
+	struct RendererStats {
+		int drawCalls = 0;
+		int ringWaits = 0;				//flushes that had to wait for the GPU to release ring space
+		int quads = 0;					//instances drawn (retained layers included)
+		int flushes[Flush_COUNT] = {};	//non-empty flushes by cause
+		int64_t bytesUploaded = 0;		//instance data written into the ring + retained layer updates
+
+		//deferred sessions only
+		int commands = 0;				//recorded submissions (quads & layers)
+		int unsortedDrawCalls = 0;		//draw calls, that the submission order would take
+		int sortedDrawCalls = 0;		//draw calls after sorting
+	};
+
+	//Single rendering session (Begin() -> End()) of a profiled frame.
+	struct PassStats {
+		const char* name;
+		RendererStats stats;
+		double cpuTime_ms = 0.0;		//spent in the session on the GL thread
+		double gpuTime_ms = -1.0;		//GL_TIME_ELAPSED of the session's commands (-1 = result not available)
+	};
+
+	struct FrameStats {
+		int frame = -1;					//-1 = no frame resolved yet
+		std::vector<PassStats> passes;
+	};
+
+	//Retained set of quads, that lives on the GPU (static scene parts, like bricks).
+	//Drawn with a single call, changes are uploaded lazily (only the modified range) on the next draw.
+	class QuadLayer {
+	public:
+		QuadLayer() = default;
+		~QuadLayer();
+
+		//copy disabled
+		QuadLayer(const QuadLayer&) = delete;
+		QuadLayer& operator=(const QuadLayer&) = delete;
+
+		//Drops all the quads.
+		void Clear();
+
+		//Appends a quad, returns its index within the layer.
+		int Add(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture, const glm::vec4& colorTint = glm::vec4(1.f));
+
+		//Hides given quad (it keeps its slot, so that other indices stay valid).
+		void Remove(int idx);
+
+		int Size() const { return int(quads.size()); }
+	private:
+		friend void RenderLayer(QuadLayer& layer);
+		friend void DrawLayer(LayerDraw& draw);
+
+		//Moves the quads modified since the last draw into the update (recording side).
+		void TakeUpdate(LayerUpdate& out);
+
+		//Uploads the update (recreates the buffer, if the layer outgrew it). GL thread only.
+		void Apply(LayerUpdate& update);
+
+		void MarkDirty(int idx);
+	private:
+		std::vector<Quad> quads;
+		std::vector<const ITexture*> textures;		//per quad
+		int dirtyBegin = 0;				//range of quads modified since the last draw
+		int dirtyEnd = 0;
+		int recordedCapacity = 0;		//buffer size, as seen by the recording side
+
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		int capacity = 0;
+
+		std::vector<Quad> softQuads;	//GL thread's copy of the quads (software backend)
+		std::vector<GLuint> slotTextures;	//textures bound for the layer's draw (texture slots - quads on the GPU reference them by index)
+	};
+
+	//Selects, where the batches get rasterized. Needs to be called before the first Begin().
+	//Software backend rasterizes on the CPU -> the same pixels on every machine. It still needs a GL 4.5 context though (texture readback,
+	//framebuffer upload & the final blit), just not ARB_bindless_texture or the shaders. Postprocessing shader has to be replaced by SoftwarePostprocess() there.
+	void SetBackend(Backend backend);
+	Backend GetBackend();
+
+	//GL backend references the textures through bindless handles, when the driver supports ARB_bindless_texture. Otherwise they're bound
+	//into texture slots (few per draw call -> extra batch breaks). Shaders have to be compiled to match (BINDLESS_TEXTURES define).
+	bool BindlessTextures();
+
+	//Shader for the following submissions (can be switched mid-session, which costs a draw call).
 	void SetShader(ShaderRef& shader);
 
 	//Begins a rendering session.
-	void Begin();
+	//Deferred session only records the submissions and draws them at End(), sorted by (layer, shader, texture, depth) into the fewest draw calls.
+	//Only the layer order is guaranteed there - quads within the same layer can get reordered (retained layers are drawn first).
+	//Pass name labels the session in the frame statistics (has to outlive the renderer - string literal).
+	void Begin(bool deferred = false, const char* pass = "pass");
+
+	//Sort layer of the following submissions (deferred sessions only, reset to 0 by Begin()).
+	void SetLayer(uint8_t layer);
 
 	//Ends rendering session (renders queued quads).
 	void End();
@@ -66,6 +184,9 @@ namespace Renderer {
 	void RenderRotatedQuad(const glm::vec3& center, const glm::vec2& halfSize, float angle_rad, const ITextureRef& texture);
 	void RenderRotatedQuad(const glm::vec3& center, const glm::vec2& halfSize, float angle_rad, const glm::vec4& color);
 
+	//Draws the whole layer (flushes the quads queued so far, to keep the order).
+	void RenderLayer(QuadLayer& layer);
+
 	void RenderText(const FontRef& font, const char* text, const glm::vec2& topLeft, float scale, const glm::vec4& color);
 	void RenderText_Centered(const FontRef& font, const char* text, const glm::vec2& center, float scale, const glm::vec4& color);
 
@@ -73,6 +194,45 @@ namespace Renderer {
 
 	void UseFBO(FramebufferRef fbo);
 
+	//Clears given render target (nullptr = default one).
+	void Clear(const FramebufferRef& fbo, const glm::vec4& color);
+
+	//Software backend only - postprocessing effects of the source framebuffer's content, drawn over the whole current target
+	//(CPU counterpart of a full-screen quad with the postproc shader).
+	void SoftwarePostprocess(const FramebufferRef& source, const SoftRaster::PostprocParams& params);
+
+	//Statistics of the last session (executed on the GL thread).
+	const RendererStats& Stats();
+
+	//===== profiling =====
+
+	//Per-pass timings & statistics, collected for every frame. GPU times come from timer queries, that are read
+	//a few frames later (without stalling) - the stats are published once all of the frame's results are in.
+	//Optionally appends a row per pass into given CSV file. Needs to be called before the first Begin().
+	void EnableProfiling(const std::string& csvFilepath = "");
+
+	//Marks the end of a frame (call after the frame's last session).
+	void EndFrame();
+
+	//Most recent frame with resolved timings (thread safe).
+	FrameStats LastFrameStats();
+
+	//Runs given function in the submission order, on the thread that owns the GL context (right away, when not recording).
+	//For GL calls outside of the renderer (clears, uniforms, resizes).
+	void Enqueue(std::function<void()> fn);
+
+	//===== frame packets =====
+
+	FramePacketRef CreatePacket();
+
+	//Redirects all the following calls into the packet (instead of executing them). Packet's previous content is dropped.
+	//Only the recording thread can use the renderer from this point on.
+	void BeginRecording(const FramePacketRef& packet);
+	void EndRecording();
+
+	//Executes the recorded calls. Has to be called from the thread that owns the GL context.
+	void Replay(const FramePacketRef& packet);
+
 	void Release();
 
 }//namespace Renderer
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "breakout/simulation.h"
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace Game {
+
+	enum class InputEventType : uint8_t {
+		Left,			//value = pressed
+		Right,			//value = pressed
+		Launch,
+		NewGame,		//game reset (lives, level counter & first level reload)
+	};
+
+	//Input change, applied right before the simulation tick with given index.
+	struct InputEvent {
+		uint32_t tick;
+		InputEventType type;
+		uint8_t value = 0;
+	};
+
+	//Recorded game session - everything needed to reproduce it (RNG seed, simulation setup & per-tick input events).
+	//Ticks are counted from the start of the session (only ticks that were actually simulated).
+	class Replay {
+	public:
+		Replay() = default;
+
+		//Starts a new recording (drops all the events).
+		void Begin(uint32_t seed, float tickRate, int stressBalls, const std::vector<std::string>& levels);
+
+		//Stores the tick's input (only changes against the previous tick end up as events).
+		void RecordTick(uint32_t tick, const SimInput& input, bool launch);
+		void RecordEvent(uint32_t tick, InputEventType type, uint8_t value = 0);
+
+		//Marks the end of the recording (number of simulated ticks).
+		void End(uint32_t tickCount);
+
+		//Playback - moves the cursor back to the first event.
+		void Rewind();
+
+		//Consumes the NewGame event, if it's next in line (scheduled for given tick or earlier).
+		bool PopNewGame(uint32_t tick);
+
+		//Applies all the input events up to given tick, stops at NewGame events (see PopNewGame()).
+		//out_input persists between calls (holds the pressed keys).
+		void PlaybackTick(uint32_t tick, SimInput& out_input, bool& out_launch);
+
+		bool Finished(uint32_t tick) const { return tick >= tickCount; }
+
+		//Binary file serialization. Return false on failure.
+		bool Save(const char* filepath) const;
+		bool Load(const char* filepath);
+	public:
+		uint32_t seed = 0;
+		float tickRate = 0.f;
+		int stressBalls = 0;
+		std::vector<std::string> levels;
+
+		std::vector<InputEvent> events;
+		uint32_t tickCount = 0;
+	private:
+		size_t cursor = 0;
+		SimInput lastInput = {};
+	};
+
+}//namespace Game
@@ -17,6 +17,9 @@ namespace Resources {
 
 	void Clear();
 
+	//Finalizes all the shaders, that are still compiling (compilations overlap, when the driver supports it).
+	void WaitForShaders();
+
 	template<typename... Args>
 	ShaderRef TryGetShader(const std::string& key, Args&&... args) {
 		ShaderRef result = GetShader(key);
@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,6 +14,9 @@
 class Shader;
 using ShaderRef = std::shared_ptr<Shader>;
 
+class UniformBuffer;
+using UniformBufferRef = std::shared_ptr<UniformBuffer>;
+
 class Shader {
 public:
 	//Load vertrex/fragment shader from provided path. Shader names differ only in extension (.vert/.frag).
@@ -20,7 +25,12 @@ public:
 	//Load vertex & fragment shader from separate paths.
 	Shader(const std::string& vertexFilepath, const std::string& fragmentFilepath);
 
+	//Load a permutation of the shader - defines ("NAME" or "NAME VALUE") are inserted right after the #version line of both sources.
+	Shader(const std::string& vertexFilepath, const std::string& fragmentFilepath, const std::vector<std::string>& defines);
+
 	//Compile shader program from provided vertex/fragment sources.
+	//Program binary is reused from the on-disk cache, when possible. Otherwise the compilation is only started,
+	//if the driver compiles in parallel (GL_KHR_parallel_shader_compile) - Finalize() has to be called before use.
 	Shader(const std::string& vertexSource, const std::string& fragmentSource, const std::string& name);
 
 	Shader() = default;
@@ -34,11 +44,22 @@ public:
 	Shader(Shader&&) noexcept;
 	Shader& operator=(Shader&&) noexcept;
 
+	//Compilation finished (Finalize() won't block).
+	bool IsReady() const;
+
+	//Waits for the compilation, checks the results & stores the program binary into the cache. Throws on compilation errors.
+	void Finalize();
+
+	bool FromCache() const { return fromCache; }
+
 	void Bind() const;
 	static void Unbind();
 
 	//== Uniform manipulation methods ==
 
+	//Cached location of an active uniform (-1 if there's none).
+	GLint Location(const char* varName) const;
+
 	void SetVec2(const char* varName, const glm::vec2& value) const;
 	void SetVec3(const char* varName, const glm::vec3& value) const;
 	void SetVec4(const char* varName, const glm::vec4& value) const;
@@ -56,9 +77,42 @@ public:
 private:
 	void Release() noexcept;
 	void Move(Shader&&) noexcept;
+
+	//Fills the location cache with all the active uniforms (done once, after linking).
+	void ReflectUniforms();
 private:
 	GLuint program = 0;
 	std::string name;
+	std::unordered_map<std::string, GLint> uniforms;		//name -> location
+
+	//program binary cache & pending compilation
+	std::string cachePath;
+	GLuint vertex = 0;
+	GLuint fragment = 0;
+	bool pending = false;
+	bool fromCache = false;
 
 	DBG_ONLY(static GLuint activeProgram);
 };
+
+//===== UniformBuffer =====
+
+//Buffer backing an uniform block (std140 layout of the data is up to the caller).
+class UniformBuffer {
+public:
+	//Buffer is bound to given uniform block binding point for its whole lifetime.
+	UniformBuffer(int size, int binding, const void* data = nullptr);
+	~UniformBuffer();
+
+	//copy disabled
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	void Update(const void* data, int size, int offset = 0);
+
+	int Binding() const { return binding; }
+private:
+	GLuint handle = 0;
+	int size = 0;
+	int binding = 0;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "breakout/glm.h"
+#include "breakout/bricks.h"
+#include "breakout/collision.h"
+
+#include <vector>
+#include <string>
+
+namespace Game {
+
+#define PLATFORM_Y_POS -0.96f
+#define PLATFORM_HEIGHT 0.03f
+#define PLATFORM_BOUNCE_STEEPNESS 1.5f
+
+#define DEFAULT_BALL_SPEED 1.5f
+#define DEFAULT_PLATFORM_SPEED 0.5f
+#define DEFAULT_PLATFORM_SCALE 0.2f
+#define STARTING_LIVES 3
+#define MAX_BALLS 16384
+
+	//==== Structs ====
+
+	struct Platform {
+		float pos = 0.f;
+		float scale;
+		float speed;
+	};
+
+	struct Ball {
+		glm::vec2 pos = glm::vec2(0.f);
+		glm::vec2 prevPos = glm::vec2(0.f);		//position before the last Update() (for render interpolation)
+		glm::vec2 dir = glm::vec2(0.f, 1.f);
+		float speed = DEFAULT_BALL_SPEED;
+		float radius = 0.05f;
+
+		bool onPlatform = true;
+	};
+
+	//Values match the 'effect' uniform in postproc shader.
+	enum class PostProcEffectType { None, Blur, Drunk, Chaos, Confuse };
+
+	struct Effects {
+		bool wallBreaker = false;
+		bool platformSticking = false;
+
+		PostProcEffectType postprocEffect = PostProcEffectType::None;
+	};
+
+	//Player's input, as seen by the simulation.
+	struct SimInput {
+		bool left = false;
+		bool right = false;
+	};
+
+	enum class SimEventType {
+		BrickHit,			//value = brick type
+		PowerUp,			//value = brick type
+		EffectChange,		//value = new PostProcEffectType
+		PlatformHit,
+		BallLost,			//value = remaining lives
+		GameOver,
+		LevelFinished,		//value = index of the next level
+		BrickDestroyed,		//value = brick index
+	};
+
+	//Side effect of a simulation step (sound, postprocessing, game flow), handled by the caller.
+	struct SimEvent {
+		SimEventType type;
+		int value = 0;
+	};
+
+	//==== Simulation ====
+
+	//Gameplay state & logic, independent of window, renderer and sound.
+	//There's no internal clock - time only advances through Update() calls.
+	//After BallLost/GameOver/LevelFinished events, caller is expected to reset the state (or load next level) before stepping again.
+	class Simulation {
+	public:
+		Simulation() = default;
+
+		//Loads level layout from given file. Returns false on failure.
+		bool LoadLevel(const char* filepath);
+
+		//Builds the level from its textual description (2 chars per brick - color & type code).
+		void ParseLevel(const std::string& levelDesc);
+
+		//Lives & level counter reset.
+		void NewGame();
+
+		//Ball & platform properties reset (speed, scale), followed by MidGameReset().
+		void Reset();
+
+		//Back to a single ball, sitting on the platform. Cancels all active effects.
+		void MidGameReset();
+
+		//Launches all the balls sitting on the platform.
+		void LaunchBall();
+
+		//Adds balls flying off the platform in a fan (stress mode). Total count is capped at MAX_BALLS.
+		void SpawnBalls(int count);
+
+		//Advances the simulation by deltaTime seconds.
+		//Generated events are available through Events() until the next Update() call.
+		void Update(float deltaTime, const SimInput& input);
+
+		const std::vector<SimEvent>& Events() const { return events; }
+
+		//Total simulated time (sum of all Update() deltas).
+		double Time() const { return time; }
+	private:
+		//Moves the ball by speed * deltaTime, using swept collision tests (multiple bounces per step).
+		//Returns true if the ball fell out through the bottom wall.
+		bool BallMovement(Ball& b, float deltaTime);
+
+		//Brick hit effects (events, power-ups, destruction) & ball's bounce.
+		void BrickContact(Ball& b, int idx);
+		void PlatformContact(Ball& b);
+
+		//Destroys the brick & clears its grid cell.
+		void RemoveBrick(int idx);
+
+
+		void Emit(SimEventType type, int value = 0);
+	public:
+		Platform p;
+		std::vector<Ball> balls;		//processed in order; only the last ball lost ends the round
+		BrickStore bricks;
+		BrickGrid grid;
+
+		int lives = STARTING_LIVES;
+		int level = 0;
+
+		glm::ivec2 fieldSize;
+		glm::vec2 brickSize;
+		float fieldOffsetY = 0.2f;
+
+		Effects effects;
+	private:
+		std::vector<SimEvent> events;
+		double time = 0.0;
+
+		BrickCandidates candidates;		//narrow-phase input, reused between steps
+		std::vector<Ball> spawned;		//multi-ball power-up balls, added at the end of the step
+	};
+
+	//Collision detection between two AABBs.
+	bool AABB_AABBCollision(const glm::vec2& aPos, const glm::vec2& aSize, const glm::vec2& bPos, const glm::vec2& bSize);
+
+}//namespace Game
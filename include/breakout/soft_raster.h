@@ -0,0 +1,66 @@
+#pragma once
+
+#include "breakout/glm.h"
+#include "breakout/thread_pool.h"
+
+#include <vector>
+#include <stdint.h>
+
+struct Quad;
+
+//CPU rasterizer for the renderer's quads (software backend) - mirrors basic_quad_shader & postproc_shader.
+//Output only depends on the inputs (no driver in the loop), so it's reproducible bit for bit.
+namespace SoftRaster {
+
+	//RGBA8 image, rows go bottom-up (same as GL textures & framebuffers).
+	struct Image {
+		int width = 0;
+		int height = 0;
+		bool repeat = false;				//sampling wraps around (GL_REPEAT), clamps to the edge otherwise
+		std::vector<uint32_t> pixels;
+	public:
+		void Resize(int width, int height);
+		void Clear(uint32_t rgba);
+	};
+
+	//Mirror of the postproc shader's uniform block.
+	struct PostprocParams {
+		glm::vec2 shakeVec = glm::vec2(0.f);
+		float offset = 1.f / 300.f;
+		int effect = 0;
+	};
+
+	//Implementation of the per-pixel shading & sampling. Scalar one is the reference, SSE one is picked on x86 (part of the x86-64 baseline).
+	enum class ShadingPath { Scalar, SSE };
+
+	ShadingPath ActiveShadingPath();
+
+	//Overrides the shading path (not thread-safe, call before drawing). Falls back to scalar, where SSE isn't available.
+	void SetShadingPath(ShadingPath path);
+
+	const char* ShadingPathName(ShadingPath path);
+
+	struct QuadSetup;
+
+	//Rasterizes the quads in horizontal bands, spread across a thread pool (each band is processed by a single thread, in the submission order).
+	class Rasterizer {
+	public:
+		//threadCount = 0 -> one thread per hardware thread.
+		Rasterizer(int threadCount = 0);
+		~Rasterizer();
+
+		//copy disabled
+		Rasterizer(const Rasterizer&) = delete;
+		Rasterizer& operator=(const Rasterizer&) = delete;
+
+		//Draws the quads (alpha blended, in given order) into the target. textures[i] belongs to quads[i] (nullptr = color only).
+		void Draw(Image& target, const Quad* quads, const Image* const* textures, int count);
+
+		//Full-screen pass with the postproc shader's effects, source is sampled over the whole target.
+		void Postprocess(const Image& source, Image& target, const PostprocParams& params);
+	private:
+		ThreadPool pool;
+		std::vector<QuadSetup> setups;
+	};
+
+}//namespace SoftRaster
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <stdint.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -44,6 +45,12 @@ public:
 	static void Unbind(int slot);
 
 	virtual glm::vec2 TexCoords(int i) const = 0;
+
+	//Bindless handle of the underlying GL texture (created & made resident on the first call).
+	virtual uint64_t BindlessHandle() const = 0;
+
+	//GL name of the underlying texture (atlas for the SubTextures).
+	virtual GLuint UnderlyingHandle() const = 0;
 protected:
 	std::string name;
 };
@@ -61,10 +68,12 @@ public:
 
 	virtual void Bind(int slot) const override;
 	virtual glm::vec2 TexCoords(int i) const override;
+	virtual uint64_t BindlessHandle() const override;
+	virtual GLuint UnderlyingHandle() const override;
 
 	bool MatchingCoords(int x, int y) const;
 
-	Texture* GetAtlas() { return atlas; }
+	Texture* GetAtlas() const { return atlas; }
 private:
 	void Move(SubTexture&&) noexcept;
 private:
@@ -104,9 +113,12 @@ public:
 
 	virtual void Bind(int slot) const override;
 	virtual glm::vec2 TexCoords(int i) const override;
+	virtual uint64_t BindlessHandle() const override;
+	virtual GLuint UnderlyingHandle() const override { return handle; }
 
 	int Width() const { return width; }
 	int Height() const { return height; }
+	const TextureParams& Params() const { return params; }
 private:
 	void Release() noexcept;
 	void Move(Texture&&) noexcept;
@@ -114,6 +126,7 @@ private:
 	void GenTexture(void* data);
 protected:
 	GLuint handle = 0;
+	mutable GLuint64 bindlessHandle = 0;	//once created, texture's storage can no longer change (Resize() recreates the texture)
 
 	int width;
 	int height;
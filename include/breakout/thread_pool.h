@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//Fixed set of worker threads for data-parallel jobs.
+class ThreadPool {
+public:
+	using JobType = std::function<void(int idx, int worker)>;
+public:
+	//threadCount = 0 -> one thread per hardware thread.
+	ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//Calls job(idx, worker) for every idx in [0, count), spread across the workers (dynamic scheduling).
+	//Blocks until all the calls are done. Worker index identifies the thread (for per-thread data).
+	void ParallelFor(int count, const JobType& job);
+
+	int ThreadCount() const { return int(threads.size()); }
+private:
+	void WorkerLoop(int worker);
+private:
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable done;
+
+	const JobType* job = nullptr;
+	int jobCount = 0;
+	std::atomic<int> nextIdx = 0;
+	int generation = 0;				//incremented with every ParallelFor() call
+	int busyWorkers = 0;
+	bool terminating = false;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+//Scoped trace zones, exported as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//Compiled out to nothing, unless BREAKOUT_TRACE is defined (cmake -DBREAKOUT_TRACE=ON).
+//
+//	void Foo() {
+//		TRACE_ZONE("Foo");		//measures the rest of the scope
+//		...
+//	}
+
+#ifdef BREAKOUT_TRACE
+
+#include <stdint.h>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
+namespace Trace {
+
+	//Monotonic timestamp - TSC ticks on x86 (cheaper than the OS clock, converted to ns on export), ns elsewhere.
+	inline uint64_t Now() {
+#ifdef TRACE_TSC
+		return __rdtsc();
+#else
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	//Stores finished zone into the calling thread's ring buffer (oldest zones get overwritten, once the ring is full).
+	//Name has to outlive the trace (string literal).
+	void Record(const char* name, uint64_t begin, uint64_t end);
+
+	//Label of the calling thread in the exported trace.
+	void SetThreadName(const char* name);
+
+	//Writes the zones of all the threads into given file. Threads should be idle (zones recorded meanwhile might be torn).
+	bool Export(const char* filepath);
+
+	struct Zone {
+		const char* name;
+		uint64_t begin;
+	public:
+		Zone(const char* name_) : name(name_), begin(Now()) {}
+		~Zone() { Record(name, begin, Now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+	};
+
+}//namespace Trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::SetThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_THREAD(name)
+
+#endif
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <memory>
+
 struct GLFWwindow;
+class Framebuffer;
 
 typedef void (*ResizeCallbackType)(int width, int height);
 
@@ -9,13 +12,27 @@ class Window {
 public:
 	static Window& Get();
 public:
-	void Init(int width, int height, const char* windowName);
+	//Headless mode creates an offscreen GL context (EGL surfaceless, or OSMesa as a fallback - no display needed)
+	//and renders into a framebuffer object instead of the window (see Framebuffer::Unbind()). Requires GLFW 3.4.
+	void Init(int width, int height, const char* windowName, bool headless = false);
 	bool IsInitialized() const { return (window != nullptr); }
+	bool IsHeadless() const { return (backbuffer != nullptr); }
 
 	bool ShouldClose() const;
 	void Close();
+	//Present() + PollEvents().
 	void SwapBuffers();
 
+	//Swaps the buffers (thread that owns the GL context).
+	void Present();
+
+	//Processes the window & input events (main thread only).
+	void PollEvents();
+
+	//Writes the default render target's content into a binary PPM (golden-image checks). Thread that owns the GL context.
+	//Meant for the headless mode - window's back buffer content is undefined after the swap.
+	bool SaveScreenshot(const char* filepath);
+
 	GLFWwindow* Handle() { return window; }
 
 	void Resize(int width, int height);
@@ -24,6 +41,7 @@ public:
 	int Height() const { return height; }
 	float AspectRatio() const { return float(width) / float(height); }
 
+	//Called from PollEvents(), on the main thread - viewport is up to the callback (GL context might be owned by other thread).
 	void SetResizeCallback(ResizeCallbackType ResizeCallback_) { ResizeCallback = ResizeCallback_; }
 
 	void Release();
@@ -47,4 +65,6 @@ private:
 
 	GLFWwindow* window = nullptr;
 	ResizeCallbackType ResizeCallback = nullptr;
+
+	std::shared_ptr<Framebuffer> backbuffer = nullptr;		//headless mode render target
 };
@@ -1,33 +1,49 @@
 #version 450 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 out vec4 FragColor;
 
-#define MAX_TEXTURES 8
-
 in vec4 color;
 in vec2 texCoords;
 in vec2 texTiling;
-in flat float textureID;
+in flat uvec2 textureHandle;    //bindless handle (BINDLESS_TEXTURES), texture slot + 1 otherwise
 in flat float alphaTexture;
 
-uniform sampler2D textures[MAX_TEXTURES];
+#ifdef BINDLESS_TEXTURES
+vec4 SampleTexture(vec2 uv) {
+    return texture(sampler2D(textureHandle), uv);
+}
+#else
+#define MAX_TEXTURE_SLOTS 8
+
+layout(binding = 0) uniform sampler2D textures[MAX_TEXTURE_SLOTS];
+
+//(samplers can't be indexed by a varying)
+vec4 SampleTexture(vec2 uv) {
+    switch (textureHandle.x) {
+        case 1u: return texture(textures[0], uv);
+        case 2u: return texture(textures[1], uv);
+        case 3u: return texture(textures[2], uv);
+        case 4u: return texture(textures[3], uv);
+        case 5u: return texture(textures[4], uv);
+        case 6u: return texture(textures[5], uv);
+        case 7u: return texture(textures[6], uv);
+        case 8u: return texture(textures[7], uv);
+    }
+    return vec4(1.0);
+}
+#endif
 
 void main() {
-    int tID = int(textureID);
+    //zero handle = color only quad
     vec4 tColor = vec4(1.0);
-    switch(tID) {
-        case 0: tColor = texture(textures[0], texCoords * texTiling); break;
-        case 1: tColor = texture(textures[1], texCoords * texTiling); break;
-        case 2: tColor = texture(textures[2], texCoords * texTiling); break;
-        case 3: tColor = texture(textures[3], texCoords * texTiling); break;
-        case 4: tColor = texture(textures[4], texCoords * texTiling); break;
-        case 5: tColor = texture(textures[5], texCoords * texTiling); break;
-        case 6: tColor = texture(textures[6], texCoords * texTiling); break;
-        case 7: tColor = texture(textures[7], texCoords * texTiling); break;
+    if (textureHandle != uvec2(0)) {
+        tColor = SampleTexture(texCoords * texTiling);
     }
 
     FragColor = (1 - alphaTexture) * (color * tColor) + alphaTexture * color * vec4(1.0, 1.0, 1.0, tColor.r);
     // FragColor = color * tColor;
-    // FragColor = vec4(vec3(tID == 0), 1.0);
     // FragColor = vec4(1.0, 0.0, 0.0, 1.0);
     // FragColor = vec4(vec3(tColor.r), 1.0);
-}
\ No newline at end of file
+}
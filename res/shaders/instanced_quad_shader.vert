@@ -0,0 +1,33 @@
+#version 450 core
+
+//per-instance attributes (one quad)
+layout(location = 0) in vec3  aCenter;
+layout(location = 1) in vec2  aHalfSize;
+layout(location = 2) in float aAngle;
+layout(location = 3) in vec4  aTexRect;
+layout(location = 4) in vec4  aColor;
+layout(location = 5) in uvec2 aTextureHandle;
+layout(location = 6) in float aAlphaTexture;
+
+out vec4 color;
+out vec2 texCoords;
+out vec2 texTiling;
+out flat uvec2 textureHandle;
+out flat float alphaTexture;
+
+void main() {
+    //corners in triangle strip order - bottom-left, top-left, bottom-right, top-right
+    bvec2 corner = bvec2((gl_VertexID & 2) != 0, (gl_VertexID & 1) != 0);
+    vec2 local = mix(vec2(-1.0), vec2(1.0), corner) * aHalfSize;
+
+    float c = cos(aAngle);
+    float s = sin(aAngle);
+    vec2 position = aCenter.xy + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+
+    gl_Position = vec4(position, aCenter.z, 1.0);
+    color       = aColor;
+    texCoords   = mix(aTexRect.xy, aTexRect.zw, corner);
+    texTiling   = vec2(1.0);
+    textureHandle = aTextureHandle;
+    alphaTexture = aAlphaTexture;
+}
@@ -1,73 +1,82 @@
 #version 450 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 out vec4 FragColor;
 
-#define MAX_TEXTURES 8
-
 in vec4 color;
 in vec2 texCoords;
 in vec2 texTiling;
-in flat float textureID;
+in flat uvec2 textureHandle;
 in flat float alphaTexture;
 
-uniform sampler2D textures[MAX_TEXTURES];
+//effect permutation (defined at load time, see Shader's defines constructor) - 0 = none, 1 = blur + shake, 2 = drunk, 3 = chaos, 4 = confuse
+#ifndef EFFECT
+#define EFFECT 0
+#endif
 
-uniform float offset = 1.0 / 300.0;
-uniform vec2 shakeVec = vec2(0);
+//scene texture (quad's bindless handle, or the first texture slot - postproc quad is alone in its batch)
+#ifdef BINDLESS_TEXTURES
+#define scene sampler2D(textureHandle)
+#else
+layout(binding = 0) uniform sampler2D sceneTexture;
+#define scene sceneTexture
+#endif
 
-// const float offset = 1.0 / 300.0;
-vec2 offsets[9] = vec2[](
-    vec2(-offset,  offset), // top-left
-    vec2( 0.0f,    offset), // top-center
-    vec2( offset,  offset), // top-right
-    vec2(-offset,  0.0f),   // center-left
-    vec2( 0.0f,    0.0f),   // center-center
-    vec2( offset,  0.0f),   // center-right
-    vec2(-offset, -offset), // bottom-left
-    vec2( 0.0f,   -offset), // bottom-center
-    vec2( offset, -offset)  // bottom-right    
-);
+//per-frame constants (std140, mirrored by PostprocParams on the CPU side)
+layout(std140, binding = 0) uniform PostprocParams {
+    vec2 shakeVec;
+    float offset;
+    int _padding;       //layout padding - CPU side keeps the current effect there (effects are compiled in as permutations)
+    vec2 uvScale;       //part of the texture, that the scene was rendered into (dynamic resolution)
+};
 
+//Scene's UVs -> texture coords of its rendered part (wraps around like GL_REPEAT, doesn't filter past the part's edge).
+vec2 SceneUV(vec2 uv) {
+    vec2 halfTexel = 0.5 / vec2(textureSize(scene, 0));
+    return clamp(fract(uv) * uvScale, halfTexel, uvScale - halfTexel);
+}
+
+#if EFFECT == 1 || EFFECT == 2
 float kernel_blur[9] = float[](
     1.0 / 16, 2.0 / 16, 1.0 / 16,
     2.0 / 16, 4.0 / 16, 2.0 / 16,
     1.0 / 16, 2.0 / 16, 1.0 / 16  
 );
-
-uniform int effect = 0;
+#endif
 
 void main() {
     vec2 tc = vec2(texCoords.x, 1 - texCoords.y);
 
-    vec3 sampleTex[9];
-    for(int i = 0; i < 9; i++) {
-        sampleTex[i] = vec3(texture(textures[1], tc + shakeVec + offsets[i]));
-    }
+#if EFFECT == 1 || EFFECT == 2
+    //blur + shake / drunk
+    vec2 offsets[9] = vec2[](
+        vec2(-offset,  offset), // top-left
+        vec2( 0.0f,    offset), // top-center
+        vec2( offset,  offset), // top-right
+        vec2(-offset,  0.0f),   // center-left
+        vec2( 0.0f,    0.0f),   // center-center
+        vec2( offset,  0.0f),   // center-right
+        vec2(-offset, -offset), // bottom-left
+        vec2( 0.0f,   -offset), // bottom-center
+        vec2( offset, -offset)  // bottom-right
+    );
 
-    vec4 color;
     vec3 clr = vec3(0.0);
-    switch(effect) {
-        default:
-        case 0:     //none
-            color = texture(textures[1], tc);
-            break;
-        case 1:     //blur + shake
-            for(int i = 0; i < 9; i++)
-                clr += sampleTex[i] * kernel_blur[i];
-            color = vec4(clr, 1.0);
-            break;
-        case 2:     //drunk
-            for(int i = 0; i < 9; i++)
-                clr += sampleTex[i] * kernel_blur[i];
-            color = vec4(clr, 1.0);
-            break;
-        case 3:     //chaos - vertical offset
-            tc.y += 0.3;
-            color = texture(textures[1], tc);
-            break;
-        case 4:     //confuse - flip vertically and invert colors
-            color = vec4(1 - texture(textures[1], texCoords).rgb, 1.0);
-            break;
-    }
+    for(int i = 0; i < 9; i++)
+        clr += vec3(texture(scene, SceneUV(tc + shakeVec + offsets[i]))) * kernel_blur[i];
+    vec4 color = vec4(clr, 1.0);
+#elif EFFECT == 3
+    //chaos - vertical offset
+    tc.y += 0.3;
+    vec4 color = texture(scene, SceneUV(tc));
+#elif EFFECT == 4
+    //confuse - flip vertically and invert colors
+    vec4 color = vec4(1 - texture(scene, SceneUV(texCoords)).rgb, 1.0);
+#else
+    //none
+    vec4 color = texture(scene, SceneUV(tc));
+#endif
 
     FragColor = color;
-}
\ No newline at end of file
+}
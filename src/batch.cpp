@@ -0,0 +1,164 @@
+#include "breakout/batch.h"
+
+#include "breakout/log.h"
+#include "breakout/utils.h"
+#include "breakout/thread_pool.h"
+
+#include <chrono>
+
+namespace Game {
+
+	//===== BatchInstance =====
+
+	BatchInstance::BatchInstance(uint32_t seed, int level, const std::string& levelDesc, int stressBalls_, bool autoplay) : stressBalls(stressBalls_) {
+		if (autoplay)
+			controller = std::make_shared<AutoPlayer>();
+		else
+			controller = std::make_shared<RandomController>(seed);
+
+		result.seed = seed;
+		result.level = level;
+
+		sim.NewGame();
+		sim.ParseLevel(levelDesc);
+		sim.Reset();
+	}
+
+	uint32_t BatchInstance::Run(float tickDelta, uint32_t maxTicks) {
+		int startingBricks = sim.bricks.AliveCount();
+		bool running = true;
+		bool firstLaunch = true;
+
+		uint32_t tick = 0;
+		for (; tick < maxTicks && running; tick++) {
+			SimInput input = {};
+			bool launch = false;
+			controller->Update(sim, tickDelta, input, launch);
+
+			if (launch) {
+				if (firstLaunch && stressBalls > 0) {
+					sim.SpawnBalls(stressBalls);
+				}
+				firstLaunch = false;
+				sim.LaunchBall();
+			}
+
+			sim.Update(tickDelta, input);
+			if (int(sim.balls.size()) > result.maxBalls)
+				result.maxBalls = int(sim.balls.size());
+
+			for (const SimEvent& e : sim.Events()) {
+				switch (e.type) {
+					case SimEventType::BallLost:
+						sim.MidGameReset();
+						firstLaunch = true;
+						break;
+					case SimEventType::GameOver:
+						result.outcome = BatchOutcome::Lost;
+						running = false;
+						break;
+					case SimEventType::LevelFinished:
+						result.outcome = BatchOutcome::Won;
+						running = false;
+						break;
+					default:
+						break;
+				}
+			}
+		}
+
+		result.ticks = tick;
+		result.livesLeft = sim.lives;
+		result.bricksDestroyed = startingBricks - sim.bricks.AliveCount();
+		return tick;
+	}
+
+	//===== BatchRunner =====
+
+	BatchRunner::BatchRunner(const BatchConfig& config_) : config(config_) {}
+
+	bool BatchRunner::Run() {
+		using clock = std::chrono::steady_clock;
+
+		if (config.levels.empty() || config.instances <= 0 || config.tickRate <= 0.f) {
+			LOG(LOG_ERROR, "Batch - invalid configuration (%d levels, %d instances).\n", (int)config.levels.size(), config.instances);
+			return false;
+		}
+
+		//level files are read only once & shared by all the instances
+		std::vector<std::string> levelDescs;
+		for (const std::string& path : config.levels) {
+			std::string desc;
+			if (!TryReadFile(path.c_str(), desc)) {
+				LOG(LOG_ERROR, "Batch - failed to load level '%s'.\n", path.c_str());
+				return false;
+			}
+			levelDescs.push_back(std::move(desc));
+		}
+
+		ThreadPool pool(config.threads);
+		threadCount = pool.ThreadCount();
+		busyTime_s.assign(threadCount, 0.0);
+		results.assign(config.instances, BatchResult());
+
+		LOG(LOG_INFO, "Batch - %d instances, %d threads, %.1f Hz, max %u ticks per instance (%s).\n", config.instances, threadCount, config.tickRate, config.maxTicks, config.autoplay ? "autoplayer" : "random inputs");
+
+		float tickDelta = 1.f / config.tickRate;
+		auto start = clock::now();
+
+		pool.ParallelFor(config.instances, [&](int idx, int worker) {
+			auto instanceStart = clock::now();
+
+			int level = idx % int(levelDescs.size());
+			BatchInstance instance = BatchInstance(config.seed + uint32_t(idx), level, levelDescs[level], config.stressBalls, config.autoplay);
+			instance.Run(tickDelta, config.maxTicks);
+			results[idx] = instance.Result();
+
+			busyTime_s[worker] += std::chrono::duration<double>(clock::now() - instanceStart).count();
+		});
+
+		wallTime_s = std::chrono::duration<double>(clock::now() - start).count();
+		return true;
+	}
+
+	void BatchRunner::Report(bool perInstance) const {
+		if (results.empty())
+			return;
+
+		if (perInstance) {
+			LOG(LOG_INFO, "instance,level,seed,outcome,ticks,lives,bricks,max_balls\n");
+			for (int i = 0; i < int(results.size()); i++) {
+				const BatchResult& r = results[i];
+				LOG(LOG_INFO, "%d,%s,%u,%s,%u,%d,%d,%d\n", i, config.levels[r.level].c_str(), r.seed, BatchOutcomeName(r.outcome), r.ticks, r.livesLeft, r.bricksDestroyed, r.maxBalls);
+			}
+		}
+
+		int outcomes[3] = {};
+		double totalTicks = 0.0;
+		for (const BatchResult& r : results) {
+			outcomes[int(r.outcome)]++;
+			totalTicks += r.ticks;
+		}
+
+		double busyTotal_s = 0.0;
+		for (double t : busyTime_s) {
+			busyTotal_s += t;
+		}
+
+		LOG(LOG_INFO, "Batch results (%d instances):\n", (int)results.size());
+		LOG(LOG_INFO, "\twon: %d, lost: %d, timed out: %d\n", outcomes[int(BatchOutcome::Won)], outcomes[int(BatchOutcome::Lost)], outcomes[int(BatchOutcome::TimedOut)]);
+		LOG(LOG_INFO, "\tticks: %.0f total, %.1f avg per instance (%.1f s simulated)\n", totalTicks, totalTicks / results.size(), totalTicks / config.tickRate);
+		LOG(LOG_INFO, "\twall time: %.3f s, thread utilization: %.1f%%\n", wallTime_s, 100.0 * busyTotal_s / (wallTime_s * threadCount));
+		LOG(LOG_INFO, "\tthroughput: %.0f ticks/s, %.0f ticks/s/core (%d threads)\n", totalTicks / wallTime_s, totalTicks / wallTime_s / threadCount, threadCount);
+	}
+
+	const char* BatchOutcomeName(BatchOutcome outcome) {
+		switch (outcome) {
+			case BatchOutcome::Won:			return "won";
+			case BatchOutcome::Lost:		return "lost";
+			case BatchOutcome::TimedOut:	return "timeout";
+			default:						return "unknown";
+		}
+	}
+
+}//namespace Game
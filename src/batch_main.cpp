@@ -0,0 +1,71 @@
+#include "breakout/log.h"
+
+#include "breakout/batch.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <filesystem>
+#include <algorithm>
+
+//Headless batch runner - simulates many independent games in parallel (balancing & soak testing).
+int main(int argc, char** argv) {
+	Game::BatchConfig config = {};
+	std::string levelsDir = "res/levels/";
+	bool perInstance = false;
+
+	//command line options
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+			config.instances = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			config.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+			config.maxTicks = uint32_t(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--tickrate") == 0 && i + 1 < argc) {
+			config.tickRate = float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			config.seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+			config.stressBalls = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+			levelsDir = argv[++i];
+		}
+		else if (strcmp(argv[i], "--autoplay") == 0) {
+			config.autoplay = true;
+		}
+		else if (strcmp(argv[i], "--csv") == 0) {
+			perInstance = true;
+		}
+		else {
+			LOG(LOG_WARN, "Unknown argument '%s'.\n", argv[i]);
+		}
+	}
+
+	//all the levels from the directory (sorted, so that instance -> level mapping is stable)
+	try {
+		for (auto& entry : std::filesystem::directory_iterator(levelsDir)) {
+			if (entry.path().extension() == ".txt") {
+				config.levels.push_back(entry.path().string());
+			}
+		}
+	}
+	catch (std::exception&) {
+		LOG(LOG_ERROR, "Levels directory not found.\n");
+		return 1;
+	}
+	std::sort(config.levels.begin(), config.levels.end());
+
+	Game::BatchRunner runner = Game::BatchRunner(config);
+	if (!runner.Run())
+		return 1;
+
+	runner.Report(perInstance);
+	return 0;
+}
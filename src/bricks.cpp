@@ -0,0 +1,109 @@
+#include "breakout/bricks.h"
+
+namespace Game {
+
+	//===== BrickStore =====
+
+	void BrickStore::Clear() {
+		x.clear();
+		y.clear();
+		type.clear();
+		color.clear();
+		alive.clear();
+
+		aliveCount = 0;
+		bricksLeft = 0;
+	}
+
+	int BrickStore::Add(int x_, int y_, int type_, int color_) {
+		int idx = Size();
+
+		x.push_back(int16_t(x_));
+		y.push_back(int16_t(y_));
+		type.push_back(uint8_t(type_));
+		color.push_back(uint8_t(color_));
+
+		if ((idx & 63) == 0)
+			alive.push_back(0);
+		alive[idx >> 6] |= (uint64_t(1) << (idx & 63));
+
+		aliveCount++;
+		if (type_ == BrickType::Brick)
+			bricksLeft++;
+
+		return idx;
+	}
+
+	void BrickStore::Remove(int idx) {
+		if (!IsAlive(idx))
+			return;
+
+		alive[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
+
+		aliveCount--;
+		if (type[idx] == BrickType::Brick)
+			bricksLeft--;
+	}
+
+	//===== BrickGrid =====
+
+	void BrickGrid::Build(const BrickStore& bricks, const glm::ivec2& fieldSize, const glm::vec2& brickSize) {
+		size = fieldSize;
+		cellSize = brickSize * 2.f;
+
+		cells.assign(size.x * size.y, -1);
+		bricks.ForEachAlive([this, &bricks](int i) {
+			At(bricks.Coords(i)) = i;
+		});
+	}
+
+	bool BrickGrid::CellRange(const glm::vec2& aabbMin, const glm::vec2& aabbMax, glm::ivec2& out_from, glm::ivec2& out_to) const {
+		//grid starts in the top-left corner, rows go downwards
+		//(small padding, so that rounding errors don't cut off bricks right at the cell boundary)
+		constexpr float eps = 1e-4f;
+		out_from = glm::ivec2(glm::floor(glm::vec2(aabbMin.x + 1.f - eps, 1.f - aabbMax.y - eps) / cellSize));
+		out_to = glm::ivec2(glm::floor(glm::vec2(aabbMax.x + 1.f + eps, 1.f - aabbMin.y + eps) / cellSize));
+
+		if (out_to.x < 0 || out_to.y < 0 || out_from.x >= size.x || out_from.y >= size.y)
+			return false;
+
+		out_from = glm::max(out_from, glm::ivec2(0));
+		out_to = glm::min(out_to, size - 1);
+		return true;
+	}
+
+	//===== BrickType =====
+
+	namespace BrickType {
+		const char* brickCodes = "BWGSTKUDLRCFM";
+
+		const char* BrickCodes() {
+			return brickCodes;
+		}
+
+		glm::ivec2 GetTypeTexCoord(int type, int color) {
+			static glm::ivec2 tc[] = {
+				glm::ivec2(1,0),		//brick - shouldn't ever be picked
+				glm::ivec2(0,2),		//wall
+				glm::ivec2(1,2),		//platform grow
+				glm::ivec2(2,2),		//platform shrink
+				glm::ivec2(3,2),		//platform sticking
+				glm::ivec2(4,2),		//wall breaker
+				glm::ivec2(5,2),		//ball speed up
+				glm::ivec2(6,2),		//ball slow down
+
+				glm::ivec2(0,3),		//blur
+				glm::ivec2(1,3),		//drunk
+				glm::ivec2(2,3),		//chaos
+				glm::ivec2(3,3),		//confuse
+				glm::ivec2(0,0),		//multi-ball (ball sprite)
+			};
+
+			if (type == BrickType::Brick)
+				return glm::ivec2(color, 0);
+			else
+				return tc[type];
+		}
+	}
+
+}//namespace Game
@@ -0,0 +1,545 @@
+#include "breakout/collision.h"
+
+#include "breakout/log.h"
+
+#include <algorithm>
+#include <mutex>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BREAKOUT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//per-function instruction set enabling (MSVC allows intrinsics without it)
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+//center of padding bricks - far enough to never collide
+#define DUMMY_BRICK_POS 1e30f
+
+//slab test replacement for 1/0 (keeps the math NaN free)
+#define INV_ZERO 1e30f
+
+namespace Game {
+
+	//===== BrickCandidates =====
+
+	void BrickCandidates::Add(int idx, const glm::vec2& pos) {
+		if (count >= int(x.size())) {
+			size_t newSize = std::max(x.size() * 2, size_t(Collision::maxBatchWidth));
+			x.resize(newSize);
+			y.resize(newSize);
+			brickIdx.resize(newSize);
+		}
+
+		x[count] = pos.x;
+		y[count] = pos.y;
+		brickIdx[count] = idx;
+		count++;
+	}
+
+	void BrickCandidates::Pad() {
+		int padded = ((count + Collision::maxBatchWidth - 1) / Collision::maxBatchWidth) * Collision::maxBatchWidth;
+		if (padded > int(x.size())) {
+			x.resize(padded);
+			y.resize(padded);
+			brickIdx.resize(padded);
+		}
+
+		for (int i = count; i < padded; i++) {
+			x[i] = y[i] = DUMMY_BRICK_POS;
+			brickIdx[i] = -1;
+		}
+	}
+
+	namespace Collision {
+
+		//Sweep query, shared by all the boxes in a batch.
+		//Box is expanded by the radius (Minkowski sum), corners of the expanded box are tested as circles.
+		struct KernelArgs {
+			float px, py;		//ball position
+			float dx, dy;		//ball movement
+			float invx, invy;	//1 / movement
+			float a;			//dot(d, d)
+			float rr;			//radius^2
+			float hx, hy;		//box half size
+			float ex, ey;		//box half size + radius
+			const float* cx;	//box centers
+			const float* cy;
+			int n;				//multiple of maxBatchWidth
+		public:
+			KernelArgs(const glm::vec2& pos, const glm::vec2& delta, float radius, const glm::vec2& boxSize);
+		};
+
+		KernelArgs::KernelArgs(const glm::vec2& pos, const glm::vec2& delta, float radius, const glm::vec2& boxSize) {
+			px = pos.x;
+			py = pos.y;
+			dx = delta.x;
+			dy = delta.y;
+			invx = (fabsf(dx) > 1e-20f) ? (1.f / dx) : INV_ZERO;
+			invy = (fabsf(dy) > 1e-20f) ? (1.f / dy) : INV_ZERO;
+			a = dx * dx + dy * dy;
+			rr = radius * radius;
+			hx = boxSize.x;
+			hy = boxSize.y;
+			ex = boxSize.x + radius;
+			ey = boxSize.y + radius;
+			cx = cy = nullptr;
+			n = 0;
+		}
+
+		//Returns index of the earliest hit candidate (or -1), out_t = its time of impact.
+		typedef int (*EarliestHitFn)(const KernelArgs& a, float& out_t);
+
+		//===== Kernels =====
+		//All the kernels have to follow the exact same sequence of operations as SweepBox(), so that the results are bit-exact.
+		//min/max are written as (a < b ? a : b) to match the SSE semantics.
+
+		static inline float Min(float a, float b) { return (a < b) ? a : b; }
+		static inline float Max(float a, float b) { return (a > b) ? a : b; }
+
+		//Swept test against a single box. Returns true on hit, out_t = time of impact (fraction of the movement).
+		static inline bool SweepBox(const KernelArgs& a, float cx, float cy, float& out_t) {
+			//slab test against the expanded box
+			float t1x = (cx - a.ex - a.px) * a.invx;
+			float t2x = (cx + a.ex - a.px) * a.invx;
+			float t1y = (cy - a.ey - a.py) * a.invy;
+			float t2y = (cy + a.ey - a.py) * a.invy;
+
+			float tEnter = Max(Min(t1x, t2x), Min(t1y, t2y));
+			float tExit = Min(Max(t1x, t2x), Max(t1y, t2y));
+			if (!(tEnter <= tExit && tExit >= 0.f && tEnter <= 1.f))
+				return false;
+
+			//entry point in the corner region -> ray vs circle (centered at the corner)
+			float t = Max(tEnter, 0.f);
+			float relx = (a.px + a.dx * t) - cx;
+			float rely = (a.py + a.dy * t) - cy;
+			if (fabsf(relx) > a.hx && fabsf(rely) > a.hy) {
+				float kx = (relx > 0.f) ? (cx + a.hx) : (cx - a.hx);
+				float ky = (rely > 0.f) ? (cy + a.hy) : (cy - a.hy);
+				float mx = a.px - kx;
+				float my = a.py - ky;
+
+				float b = mx * a.dx + my * a.dy;
+				float c = (mx * mx + my * my) - a.rr;
+				float disc = b * b - a.a * c;
+				float tc = (0.f - b - sqrtf(disc)) / a.a;
+
+				if (c <= 0.f) {
+					//already touching the corner
+					t = 0.f;
+				}
+				else if (b < 0.f && disc >= 0.f && tc <= 1.f) {
+					t = tc;
+				}
+				else
+					return false;
+			}
+
+			out_t = t;
+			return true;
+		}
+
+		//Reference implementation.
+		static int EarliestHit_Scalar(const KernelArgs& a, float& out_t) {
+			float best = 2.f;
+			int bestIdx = -1;
+
+			for (int i = 0; i < a.n; i++) {
+				float t;
+				if (SweepBox(a, a.cx[i], a.cy[i], t) && t < best) {
+					best = t;
+					bestIdx = i;
+				}
+			}
+
+			out_t = best;
+			return bestIdx;
+		}
+
+		//Picks the earliest hit from per-lane results (ties go to the lower candidate index).
+		static int ReduceLanes(const float* t, const int* idx, int lanes, float& out_t) {
+			int result = -1;
+			for (int l = 0; l < lanes; l++) {
+				if (idx[l] < 0)
+					continue;
+				if (result < 0 || t[l] < out_t || (t[l] == out_t && idx[l] < result)) {
+					result = idx[l];
+					out_t = t[l];
+				}
+			}
+			return result;
+		}
+
+#ifdef BREAKOUT_X86
+		//SSE2 is part of the x86-64 baseline -> no target attribute needed.
+		static int EarliestHit_SSE(const KernelArgs& a, float& out_t) {
+			const __m128 px = _mm_set1_ps(a.px), py = _mm_set1_ps(a.py);
+			const __m128 dx = _mm_set1_ps(a.dx), dy = _mm_set1_ps(a.dy);
+			const __m128 invx = _mm_set1_ps(a.invx), invy = _mm_set1_ps(a.invy);
+			const __m128 hx = _mm_set1_ps(a.hx), hy = _mm_set1_ps(a.hy);
+			const __m128 ex = _mm_set1_ps(a.ex), ey = _mm_set1_ps(a.ey);
+			const __m128 aa = _mm_set1_ps(a.a), rr = _mm_set1_ps(a.rr);
+			const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+			const __m128 allSet = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			const __m128i step = _mm_set1_epi32(4);
+
+			__m128 best = _mm_set1_ps(2.f);
+			__m128i bestIdx = _mm_set1_epi32(-1);
+			__m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+
+			for (int i = 0; i < a.n; i += 4) {
+				__m128 cx = _mm_loadu_ps(a.cx + i);
+				__m128 cy = _mm_loadu_ps(a.cy + i);
+
+				//slab test
+				__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(cx, ex), px), invx);
+				__m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(cx, ex), px), invx);
+				__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(cy, ey), py), invy);
+				__m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(cy, ey), py), invy);
+
+				__m128 tEnter = _mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y));
+				__m128 tExit = _mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y));
+				__m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(tEnter, tExit), _mm_cmpge_ps(tExit, zero)), _mm_cmple_ps(tEnter, one));
+
+				//corner region
+				__m128 t = _mm_max_ps(tEnter, zero);
+				__m128 relx = _mm_sub_ps(_mm_add_ps(px, _mm_mul_ps(dx, t)), cx);
+				__m128 rely = _mm_sub_ps(_mm_add_ps(py, _mm_mul_ps(dy, t)), cy);
+				__m128 corner = _mm_and_ps(_mm_cmpgt_ps(_mm_and_ps(relx, absMask), hx), _mm_cmpgt_ps(_mm_and_ps(rely, absMask), hy));
+
+				__m128 kxPos = _mm_cmpgt_ps(relx, zero);
+				__m128 kyPos = _mm_cmpgt_ps(rely, zero);
+				__m128 kx = _mm_or_ps(_mm_and_ps(kxPos, _mm_add_ps(cx, hx)), _mm_andnot_ps(kxPos, _mm_sub_ps(cx, hx)));
+				__m128 ky = _mm_or_ps(_mm_and_ps(kyPos, _mm_add_ps(cy, hy)), _mm_andnot_ps(kyPos, _mm_sub_ps(cy, hy)));
+				__m128 mx = _mm_sub_ps(px, kx);
+				__m128 my = _mm_sub_ps(py, ky);
+
+				__m128 b = _mm_add_ps(_mm_mul_ps(mx, dx), _mm_mul_ps(my, dy));
+				__m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), rr);
+				__m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(aa, c));
+				__m128 tc = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(disc)), aa);
+
+				__m128 touching = _mm_cmple_ps(c, zero);
+				__m128 cornerHit = _mm_or_ps(touching, _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(b, zero), _mm_cmpge_ps(disc, zero)), _mm_cmple_ps(tc, one)));
+				tc = _mm_andnot_ps(touching, tc);
+
+				t = _mm_or_ps(_mm_and_ps(corner, tc), _mm_andnot_ps(corner, t));
+				hit = _mm_and_ps(hit, _mm_or_ps(_mm_andnot_ps(corner, allSet), cornerHit));
+
+				//keep the earliest hit per lane
+				__m128 closer = _mm_and_ps(hit, _mm_cmplt_ps(t, best));
+				__m128i closerI = _mm_castps_si128(closer);
+				best = _mm_or_ps(_mm_and_ps(closer, t), _mm_andnot_ps(closer, best));
+				bestIdx = _mm_or_si128(_mm_and_si128(closerI, idx), _mm_andnot_si128(closerI, bestIdx));
+
+				idx = _mm_add_epi32(idx, step);
+			}
+
+			alignas(16) float tl[4];
+			alignas(16) int id[4];
+			_mm_store_ps(tl, best);
+			_mm_store_si128((__m128i*)id, bestIdx);
+			return ReduceLanes(tl, id, 4, out_t);
+		}
+
+		TARGET_AVX2 static int EarliestHit_AVX2(const KernelArgs& a, float& out_t) {
+			const __m256 px = _mm256_set1_ps(a.px), py = _mm256_set1_ps(a.py);
+			const __m256 dx = _mm256_set1_ps(a.dx), dy = _mm256_set1_ps(a.dy);
+			const __m256 invx = _mm256_set1_ps(a.invx), invy = _mm256_set1_ps(a.invy);
+			const __m256 hx = _mm256_set1_ps(a.hx), hy = _mm256_set1_ps(a.hy);
+			const __m256 ex = _mm256_set1_ps(a.ex), ey = _mm256_set1_ps(a.ey);
+			const __m256 aa = _mm256_set1_ps(a.a), rr = _mm256_set1_ps(a.rr);
+			const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f);
+			const __m256 allSet = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+			const __m256i step = _mm256_set1_epi32(8);
+
+			__m256 best = _mm256_set1_ps(2.f);
+			__m256i bestIdx = _mm256_set1_epi32(-1);
+			__m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+			for (int i = 0; i < a.n; i += 8) {
+				__m256 cx = _mm256_loadu_ps(a.cx + i);
+				__m256 cy = _mm256_loadu_ps(a.cy + i);
+
+				//slab test
+				__m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(cx, ex), px), invx);
+				__m256 t2x = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(cx, ex), px), invx);
+				__m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(cy, ey), py), invy);
+				__m256 t2y = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(cy, ey), py), invy);
+
+				__m256 tEnter = _mm256_max_ps(_mm256_min_ps(t1x, t2x), _mm256_min_ps(t1y, t2y));
+				__m256 tExit = _mm256_min_ps(_mm256_max_ps(t1x, t2x), _mm256_max_ps(t1y, t2y));
+				__m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ), _mm256_cmp_ps(tExit, zero, _CMP_GE_OQ)), _mm256_cmp_ps(tEnter, one, _CMP_LE_OQ));
+
+				//corner region
+				__m256 t = _mm256_max_ps(tEnter, zero);
+				__m256 relx = _mm256_sub_ps(_mm256_add_ps(px, _mm256_mul_ps(dx, t)), cx);
+				__m256 rely = _mm256_sub_ps(_mm256_add_ps(py, _mm256_mul_ps(dy, t)), cy);
+				__m256 corner = _mm256_and_ps(_mm256_cmp_ps(_mm256_and_ps(relx, absMask), hx, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_and_ps(rely, absMask), hy, _CMP_GT_OQ));
+
+				__m256 kx = _mm256_blendv_ps(_mm256_sub_ps(cx, hx), _mm256_add_ps(cx, hx), _mm256_cmp_ps(relx, zero, _CMP_GT_OQ));
+				__m256 ky = _mm256_blendv_ps(_mm256_sub_ps(cy, hy), _mm256_add_ps(cy, hy), _mm256_cmp_ps(rely, zero, _CMP_GT_OQ));
+				__m256 mx = _mm256_sub_ps(px, kx);
+				__m256 my = _mm256_sub_ps(py, ky);
+
+				__m256 b = _mm256_add_ps(_mm256_mul_ps(mx, dx), _mm256_mul_ps(my, dy));
+				__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my)), rr);
+				__m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(aa, c));
+				__m256 tc = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(disc)), aa);
+
+				__m256 touching = _mm256_cmp_ps(c, zero, _CMP_LE_OQ);
+				__m256 cornerHit = _mm256_or_ps(touching, _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(b, zero, _CMP_LT_OQ), _mm256_cmp_ps(disc, zero, _CMP_GE_OQ)), _mm256_cmp_ps(tc, one, _CMP_LE_OQ)));
+				tc = _mm256_blendv_ps(tc, zero, touching);
+
+				t = _mm256_blendv_ps(t, tc, corner);
+				hit = _mm256_and_ps(hit, _mm256_blendv_ps(allSet, cornerHit, corner));
+
+				//keep the earliest hit per lane
+				__m256 closer = _mm256_and_ps(hit, _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+				best = _mm256_blendv_ps(best, t, closer);
+				bestIdx = _mm256_blendv_epi8(bestIdx, idx, _mm256_castps_si256(closer));
+
+				idx = _mm256_add_epi32(idx, step);
+			}
+
+			alignas(32) float tl[8];
+			alignas(32) int id[8];
+			_mm256_store_ps(tl, best);
+			_mm256_store_si256((__m256i*)id, bestIdx);
+			return ReduceLanes(tl, id, 8, out_t);
+		}
+
+		TARGET_AVX512 static int EarliestHit_AVX512(const KernelArgs& a, float& out_t) {
+			const __m512 px = _mm512_set1_ps(a.px), py = _mm512_set1_ps(a.py);
+			const __m512 dx = _mm512_set1_ps(a.dx), dy = _mm512_set1_ps(a.dy);
+			const __m512 invx = _mm512_set1_ps(a.invx), invy = _mm512_set1_ps(a.invy);
+			const __m512 hx = _mm512_set1_ps(a.hx), hy = _mm512_set1_ps(a.hy);
+			const __m512 ex = _mm512_set1_ps(a.ex), ey = _mm512_set1_ps(a.ey);
+			const __m512 aa = _mm512_set1_ps(a.a), rr = _mm512_set1_ps(a.rr);
+			const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.f);
+			const __m512i step = _mm512_set1_epi32(16);
+
+			__m512 best = _mm512_set1_ps(2.f);
+			__m512i bestIdx = _mm512_set1_epi32(-1);
+			__m512i idx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+			for (int i = 0; i < a.n; i += 16) {
+				__m512 cx = _mm512_loadu_ps(a.cx + i);
+				__m512 cy = _mm512_loadu_ps(a.cy + i);
+
+				//slab test
+				__m512 t1x = _mm512_mul_ps(_mm512_sub_ps(_mm512_sub_ps(cx, ex), px), invx);
+				__m512 t2x = _mm512_mul_ps(_mm512_sub_ps(_mm512_add_ps(cx, ex), px), invx);
+				__m512 t1y = _mm512_mul_ps(_mm512_sub_ps(_mm512_sub_ps(cy, ey), py), invy);
+				__m512 t2y = _mm512_mul_ps(_mm512_sub_ps(_mm512_add_ps(cy, ey), py), invy);
+
+				__m512 tEnter = _mm512_max_ps(_mm512_min_ps(t1x, t2x), _mm512_min_ps(t1y, t2y));
+				__m512 tExit = _mm512_min_ps(_mm512_max_ps(t1x, t2x), _mm512_max_ps(t1y, t2y));
+				__mmask16 hit = _mm512_cmp_ps_mask(tEnter, tExit, _CMP_LE_OQ) & _mm512_cmp_ps_mask(tExit, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tEnter, one, _CMP_LE_OQ);
+
+				//corner region
+				__m512 t = _mm512_max_ps(tEnter, zero);
+				__m512 relx = _mm512_sub_ps(_mm512_add_ps(px, _mm512_mul_ps(dx, t)), cx);
+				__m512 rely = _mm512_sub_ps(_mm512_add_ps(py, _mm512_mul_ps(dy, t)), cy);
+				__mmask16 corner = _mm512_cmp_ps_mask(_mm512_abs_ps(relx), hx, _CMP_GT_OQ) & _mm512_cmp_ps_mask(_mm512_abs_ps(rely), hy, _CMP_GT_OQ);
+
+				__m512 kx = _mm512_mask_mov_ps(_mm512_sub_ps(cx, hx), _mm512_cmp_ps_mask(relx, zero, _CMP_GT_OQ), _mm512_add_ps(cx, hx));
+				__m512 ky = _mm512_mask_mov_ps(_mm512_sub_ps(cy, hy), _mm512_cmp_ps_mask(rely, zero, _CMP_GT_OQ), _mm512_add_ps(cy, hy));
+				__m512 mx = _mm512_sub_ps(px, kx);
+				__m512 my = _mm512_sub_ps(py, ky);
+
+				__m512 b = _mm512_add_ps(_mm512_mul_ps(mx, dx), _mm512_mul_ps(my, dy));
+				__m512 c = _mm512_sub_ps(_mm512_add_ps(_mm512_mul_ps(mx, mx), _mm512_mul_ps(my, my)), rr);
+				__m512 disc = _mm512_sub_ps(_mm512_mul_ps(b, b), _mm512_mul_ps(aa, c));
+				__m512 tc = _mm512_div_ps(_mm512_sub_ps(_mm512_sub_ps(zero, b), _mm512_sqrt_ps(disc)), aa);
+
+				__mmask16 touching = _mm512_cmp_ps_mask(c, zero, _CMP_LE_OQ);
+				__mmask16 cornerHit = touching | (_mm512_cmp_ps_mask(b, zero, _CMP_LT_OQ) & _mm512_cmp_ps_mask(disc, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(tc, one, _CMP_LE_OQ));
+				tc = _mm512_mask_mov_ps(tc, touching, zero);
+
+				t = _mm512_mask_mov_ps(t, corner, tc);
+				hit = hit & (~corner | cornerHit);
+
+				//keep the earliest hit per lane
+				__mmask16 closer = hit & _mm512_cmp_ps_mask(t, best, _CMP_LT_OQ);
+				best = _mm512_mask_mov_ps(best, closer, t);
+				bestIdx = _mm512_mask_mov_epi32(bestIdx, closer, idx);
+
+				idx = _mm512_add_epi32(idx, step);
+			}
+
+			alignas(64) float tl[16];
+			alignas(64) int id[16];
+			_mm512_store_ps(tl, best);
+			_mm512_store_si512((void*)id, bestIdx);
+			return ReduceLanes(tl, id, 16, out_t);
+		}
+#endif
+
+		//===== Dispatch =====
+
+		struct Dispatch {
+			InstructionSet set = InstructionSet::Scalar;
+			EarliestHitFn EarliestHit = EarliestHit_Scalar;
+		};
+
+		static InstructionSet DetectInstructionSet() {
+#ifdef BREAKOUT_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+
+			//check that the OS saves AVX (& AVX-512) registers
+			__cpuid(info, 1);
+			bool osAVX = false, osAVX512 = false;
+			if ((info[2] & (1 << 27)) && (info[2] & (1 << 28))) {
+				unsigned long long xcr0 = _xgetbv(0);
+				osAVX = (xcr0 & 0x6) == 0x6;
+				osAVX512 = (xcr0 & 0xe6) == 0xe6;
+			}
+
+			if (maxLeaf >= 7) {
+				__cpuidex(info, 7, 0);
+				if (osAVX512 && (info[1] & (1 << 16)))
+					return InstructionSet::AVX512;
+				if (osAVX && (info[1] & (1 << 5)))
+					return InstructionSet::AVX2;
+			}
+			return InstructionSet::SSE;
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f"))
+				return InstructionSet::AVX512;
+			if (__builtin_cpu_supports("avx2"))
+				return InstructionSet::AVX2;
+			return InstructionSet::SSE;
+#endif
+#else
+			return InstructionSet::Scalar;
+#endif
+		}
+
+		static EarliestHitFn GetKernel(InstructionSet set) {
+			switch (set) {
+#ifdef BREAKOUT_X86
+				case InstructionSet::SSE:		return EarliestHit_SSE;
+				case InstructionSet::AVX2:		return EarliestHit_AVX2;
+				case InstructionSet::AVX512:	return EarliestHit_AVX512;
+#endif
+				default:						return EarliestHit_Scalar;
+			}
+		}
+
+		static Dispatch SelectKernel(InstructionSet requested) {
+			Dispatch d;
+
+			InstructionSet supported = DetectInstructionSet();
+			d.set = (int(requested) <= int(supported)) ? requested : supported;
+			d.EarliestHit = GetKernel(d.set);
+
+			LOG(LOG_INFO, "Collision - using %s kernels.\n", InstructionSetName(d.set));
+			return d;
+		}
+
+		static Dispatch dispatch;
+		static std::once_flag dispatchSelected;
+
+		static const Dispatch& GetDispatch() {
+			std::call_once(dispatchSelected, []() { dispatch = SelectKernel(InstructionSet::AVX512); });
+			return dispatch;
+		}
+
+		InstructionSet ActiveInstructionSet() {
+			return GetDispatch().set;
+		}
+
+		void SetInstructionSet(InstructionSet set) {
+			std::call_once(dispatchSelected, []() {});
+			dispatch = SelectKernel(set);
+		}
+
+		const char* InstructionSetName(InstructionSet set) {
+			switch (set) {
+				case InstructionSet::SSE:		return "SSE2";
+				case InstructionSet::AVX2:		return "AVX2";
+				case InstructionSet::AVX512:	return "AVX-512";
+				default:						return "scalar";
+			}
+		}
+
+		//===== Collision tests =====
+
+		bool SweptCircle_AABB(const glm::vec2& pos, const glm::vec2& delta, float radius, const glm::vec2& boxPos, const glm::vec2& boxSize, float& out_t) {
+			KernelArgs a = KernelArgs(pos, delta, radius, boxSize);
+			return SweepBox(a, boxPos.x, boxPos.y, out_t);
+		}
+
+		glm::vec2 Circle_AABBContact(const glm::vec2& pos, float radius, const glm::vec2& boxPos, const glm::vec2& boxSize, float skin, glm::vec2& out_posFix) {
+			glm::vec2 boxMin = boxPos - boxSize;
+			glm::vec2 boxMax = boxPos + boxSize;
+
+			glm::vec2 P = glm::clamp(pos, boxMin, boxMax);
+			glm::vec2 a = pos - P;
+			float dist = glm::length(a);
+
+			glm::vec2 n;
+			if (dist > 1e-6f) {
+				//normal points from the closest point on the box to the circle's center
+				n = a / dist;
+				out_posFix = n * (radius + skin - dist);
+			}
+			else {
+				//center inside the box -> push out through the nearest side
+				glm::vec2 rel = pos - boxPos;
+				glm::vec2 penetration = boxSize - glm::abs(rel);
+				if (penetration.x < penetration.y) {
+					n = glm::vec2((rel.x < 0.f) ? -1.f : 1.f, 0.f);
+					out_posFix = n * (penetration.x + radius + skin);
+				}
+				else {
+					n = glm::vec2(0.f, (rel.y < 0.f) ? -1.f : 1.f);
+					out_posFix = n * (penetration.y + radius + skin);
+				}
+			}
+
+			return n;
+		}
+
+		bool Ball_BricksSweep(const glm::vec2& ballPos, const glm::vec2& delta, float radius, const glm::vec2& brickSize, BrickCandidates& candidates, BrickHit& out_hit) {
+			if (candidates.count < 1)
+				return false;
+
+			candidates.Pad();
+
+			KernelArgs a = KernelArgs(ballPos, delta, radius, brickSize);
+			a.cx = candidates.x.data();
+			a.cy = candidates.y.data();
+			a.n = ((candidates.count + maxBatchWidth - 1) / maxBatchWidth) * maxBatchWidth;
+
+			float t;
+			int i = GetDispatch().EarliestHit(a, t);
+			if (i < 0)
+				return false;
+
+			out_hit.brickIdx = candidates.brickIdx[i];
+			out_hit.t = t;
+			return true;
+		}
+
+	}//namespace Collision
+
+}//namespace Game
@@ -0,0 +1,105 @@
+#include "breakout/controller.h"
+
+#include <math.h>
+
+namespace Game {
+
+#define INPUT_HOLD_MIN 0.05f		//random player's input change interval (seconds)
+#define INPUT_HOLD_MAX 0.5f
+
+#define AUTOPLAY_AIM_OFFSET 0.35f	//hit point offset from the platform's center (fraction of platform's half-width), bounces the ball towards the field's center
+
+	//===== RandomController =====
+
+	RandomController::RandomController(uint32_t seed) : rng(seed) {}
+
+	void RandomController::Update(const Simulation& sim, float deltaTime, SimInput& out_input, bool& out_launch) {
+		out_launch = sim.balls[0].onPlatform;
+
+		inputHold -= deltaTime;
+		if (inputHold <= 0.f) {
+			//new random direction (or none), held for a random interval
+			std::uniform_int_distribution<int> direction(0, 2);
+			std::uniform_real_distribution<float> hold(INPUT_HOLD_MIN, INPUT_HOLD_MAX);
+
+			int d = direction(rng);
+			input.left = (d == 1);
+			input.right = (d == 2);
+			inputHold = hold(rng);
+		}
+
+		out_input = input;
+	}
+
+	//===== AutoPlayer =====
+
+	AutoPlayer::AutoPlayer(float launchDelay_) : launchDelay(launchDelay_) {}
+
+	void AutoPlayer::Update(const Simulation& sim, float deltaTime, SimInput& out_input, bool& out_launch) {
+		const Platform& p = sim.p;
+
+		//pick the ball that lands first
+		float target = p.pos;
+		float bestTime = INFINITY;
+		bool anyOnPlatform = false;
+		for (const Ball& b : sim.balls) {
+			if (b.onPlatform) {
+				anyOnPlatform = true;
+				continue;
+			}
+
+			float t;
+			float x = PredictLandingX(b, t);
+			if (t < bestTime) {
+				bestTime = t;
+
+				//aim slightly off-center, so that the ball bounces back towards the middle
+				float aim = (x < 0.f) ? -1.f : 1.f;
+				target = x + aim * AUTOPLAY_AIM_OFFSET * p.scale;
+			}
+		}
+
+		//launch once the balls have been sitting on the platform for a while
+		out_launch = false;
+		if (anyOnPlatform) {
+			launchTimer += deltaTime;
+			if (launchTimer >= launchDelay) {
+				out_launch = true;
+				launchTimer = 0.f;
+			}
+		}
+		else {
+			launchTimer = 0.f;
+		}
+
+		//move towards the target (dead zone of one step, so that the platform doesn't jitter around it)
+		float deadZone = p.speed * deltaTime;
+		out_input.left = (target < p.pos - deadZone);
+		out_input.right = (target > p.pos + deadZone);
+	}
+
+	float AutoPlayer::PredictLandingX(const Ball& b, float& out_timeToLand) {
+		float landY = PLATFORM_Y_POS + PLATFORM_HEIGHT + b.radius;
+		float topY = 1.f - b.radius;
+		float sideX = 1.f - b.radius;
+
+		//vertical distance to travel (up to the top wall & back, if going up)
+		float dy = fabsf(b.dir.y);
+		float distY = (b.dir.y > 0.f) ? (topY - b.pos.y) + (topY - landY) : (b.pos.y - landY);
+		if (dy < 1e-4f || distY < 0.f) {
+			//flying horizontally or already below the platform
+			out_timeToLand = (dy < 1e-4f) ? INFINITY : 0.f;
+			return b.pos.x;
+		}
+		out_timeToLand = distY / (dy * b.speed);
+
+		//unfold side wall bounces (position in a mirrored space with period 4 * sideX)
+		float x = b.pos.x + b.dir.x / dy * distY;
+		float period = 4.f * sideX;
+		float u = fmodf(x + sideX, period);
+		if (u < 0.f)
+			u += period;
+		return (u <= 2.f * sideX) ? (u - sideX) : (3.f * sideX - u);
+	}
+
+}//namespace Game
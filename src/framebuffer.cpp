@@ -5,10 +5,13 @@
 
 #include "breakout/texture.h"
 #include <memory>
+#include <algorithm>
 
 #define HANDLE_CHECK() ASSERT_MSG(handle != 0, "\tAttempting to use uninitialized framebuffer.\n")
 
-Framebuffer::Framebuffer(int width_, int height_, GLenum internalFormat_, const TextureParams& tParams) : width(width_), height(height_), internalFormat(internalFormat_) {
+GLuint Framebuffer::backbuffer = 0;
+
+Framebuffer::Framebuffer(int width_, int height_, GLenum internalFormat_, const TextureParams& tParams) : width(width_), height(height_), viewportWidth(width_), viewportHeight(height_), internalFormat(internalFormat_) {
 	glGenFramebuffers(1, &handle);
 	glBindFramebuffer(GL_FRAMEBUFFER, handle);
 
@@ -24,23 +27,38 @@ Framebuffer::Framebuffer(int width_, int height_, GLenum internalFormat_, const
 }
 
 void Framebuffer::Resize(int newWidth, int newHeight) {
-	width = newWidth;
-	height = newHeight;
+	width = viewportWidth = newWidth;
+	height = viewportHeight = newHeight;
 
 	texture->Resize(width, height);
 
+	//texture object might have been recreated (bindless handle)
+	glBindFramebuffer(GL_FRAMEBUFFER, handle);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->Handle(), 0);
+
 	if (!IsComplete()) {
 		throw std::exception();
 	}
 }
 
+void Framebuffer::SetViewport(int width_, int height_) {
+	viewportWidth = std::min(std::max(width_, 1), width);
+	viewportHeight = std::min(std::max(height_, 1), height);
+}
+
 void Framebuffer::Bind() const {
 	HANDLE_CHECK();
 	glBindFramebuffer(GL_FRAMEBUFFER, handle);
+	glViewport(0, 0, viewportWidth, viewportHeight);
 }
 
 void Framebuffer::Unbind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, backbuffer);
+	glViewport(0, 0, Window::Get().Width(), Window::Get().Height());
+}
+
+void Framebuffer::SetBackbuffer(const Framebuffer* fbo) {
+	backbuffer = (fbo != nullptr) ? fbo->handle : 0;
 }
 
 bool Framebuffer::IsComplete() const {
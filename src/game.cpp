@@ -10,6 +10,10 @@
 #include "breakout/framebuffer.h"
 #include "breakout/particles.h"
 #include "breakout/sound.h"
+#include "breakout/trace.h"
+#include "breakout/replay.h"
+#include "breakout/controller.h"
+#include "breakout/render_thread.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -17,20 +21,34 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <memory>
+#include <time.h>
 
 namespace Game {
 
-#define PLATFORM_Y_POS -0.96f
-#define PLATFORM_HEIGHT 0.03f
-#define PLATFORM_BOUNCE_STEEPNESS 1.5f
-
 #define RESET_DELAY_SEC 1.25f
 #define FADEIN_DURATION_SEC 0.5f
 
-#define DEFAULT_BALL_SPEED 1.5f
-#define DEFAULT_PLATFORM_SPEED 0.5f
-#define DEFAULT_PLATFORM_SCALE 0.2f
-#define STARTING_LIVES 3
+#define DEFAULT_TICK_RATE 240.f
+
+#define AUTOPLAY_LAUNCH_DELAY_SEC 0.5f
+
+#define EMISSION_MAX_BALLS 16		//max number of balls emitting particles in a single tick
+
+//sort layers of the (deferred) scene pass - order within a layer isn't preserved
+#define SCENE_LAYER_MAIN 0
+#define SCENE_LAYER_MESSAGE 1
+#define SCENE_LAYER_FADE 2
+
+#define POSTPROC_PARAMS_BINDING 0	//uniform block binding of the postprocessing constants
+#define POSTPROC_EFFECT_COUNT 5		//PostProcEffectType values (postproc shader permutations)
+
+//dynamic resolution - scene framebuffer's size relative to the window
+#define DYNRES_MIN_SCALE 0.5f
+#define DYNRES_STEP 0.05f			//scale granularity (each change reallocates the framebuffer)
+#define DYNRES_COOLDOWN 30			//profiled frames between the changes (previous change has to show up in the timings first)
+#define DYNRES_HEADROOM 0.8f		//scale goes up only while the frame cost is below this fraction of the budget
+#define DYNRES_SMOOTHING 0.1f		//weight of the latest frame in the smoothed frame cost
 
 	struct InputState {
 		bool left = false;
@@ -63,30 +81,72 @@ namespace Game {
 		Menu, Options, Play
 	};
 
-	enum class PostProcEffectType { None, Blur, Drunk, Chaos, Confuse };
-	
-	struct Effects {
-		bool wallBreaker = false;
-		bool platformSticking = false;
+	enum class ReplayMode {
+		None, Record, Playback
+	};
 
-		PostProcEffectType postprocEffect = PostProcEffectType::None;
+	//Postprocessing per-frame constants (std140 uniform block in postproc_shader.frag).
+	struct PostprocParams {
+		glm::vec2 shakeVec = glm::vec2(0.f);
+		float offset = 1.f / 300.f;
+		int effect = 0;						//CPU side only - occupies the block's padding (shader reads the effect from its permutation)
+		glm::vec2 uvScale = glm::vec2(1.f);	//part of the scene framebuffer, that's rendered into (dynamic resolution)
+		glm::vec2 _padding = glm::vec2(0.f);
 	};
+	static_assert(sizeof(PostprocParams) == 32, "PostprocParams has to match the std140 layout.");
 
 	struct InGameState {
-		Platform p;
-		Ball b;
-		std::vector<Brick> bricks;
-
 		GameState state;
 		InputState inputs;
 		float deltaTime = 0.f;
 
-		int lives = STARTING_LIVES;
-		int level = 0;
-		
-		glm::ivec2 fieldSize;
-		glm::vec2 brickSize;
-		float fieldOffsetY = 0.2f;
+		//fixed-step simulation
+		float tickDelta = 1.f / DEFAULT_TICK_RATE;
+		float tickAccumulator = 0.f;
+		float renderAlpha = 1.f;			//interpolation factor between the last two ticks
+		float prevPlatformPos = 0.f;
+
+		uint32_t tick = 0;					//ticks simulated since the start of the session
+		bool launchRequested = false;		//launch input, applied on the next tick
+
+		std::string tracePath;				//Chrome trace output (empty = none)
+
+		//headless runs (benchmarks & golden images)
+		bool headless = false;				//offscreen GL context, no window
+		bool softwareRenderer = false;		//quads are rasterized on the CPU (Renderer::Backend::Software)
+		int frameLimit = 0;					//quit after given number of frames (0 = no limit)
+		std::string screenshotPath;			//final frame output (empty = none)
+
+		//frame pacing
+		bool useRenderThread = false;		//GL calls are recorded & replayed on a dedicated thread
+		double frameStart = 0.0;			//input sampling time of the current frame
+		int frames = 0;
+		FrameTimings timings;				//direct presentation only (render thread measures its own)
+
+		//dynamic resolution (scene pass is rendered at a fraction of the window's resolution & upscaled by the postprocessing pass)
+		float frameBudget_ms = 0.f;			//target cost of the frame's rendering (0 = fixed native resolution)
+		float renderScale = 1.f;			//<DYNRES_MIN_SCALE, 1>
+		double frameCost_ms = 0.0;			//smoothed rendering cost (sum of the passes' CPU/GPU time, whichever is longer)
+		int scaledFrame = -1;				//last profiled frame, that the controller took into account
+		int scaleCooldown = 0;
+
+		//renderer profiling
+		bool profiling = false;
+		bool statsOverlay = false;			//per-pass stats drawn over the GUI (toggled by F3)
+		std::string statsPath;				//CSV output (empty = none)
+
+		//stress mode - swarm of balls launched at the start of each round
+		int stressBalls = 0;
+		bool stressPending = false;
+
+		//input recording & playback
+		uint32_t seed = 0;
+		ReplayMode replayMode = ReplayMode::None;
+		std::string replayPath;
+		Replay replay;
+		SimInput replayInput;
+
+		IControllerRef controller = nullptr;		//replaces keyboard input, if set (autoplayer)
 
 		GameState transition_nextState;
 		float transition_endTime = 0.f;
@@ -101,15 +161,17 @@ namespace Game {
 		MenuState menuState = MenuState::Menu;
 
 		std::vector<Button> activeButtons;
-		Effects effects;
-		int bricksLeft = 0;
 
 		ParticleSystem emission;
+		int emissionOffset = 0;		//first emitting ball (rotates when only every n-th ball emits), consumes rand() -> reset with the game state
+
+		PostprocParams postproc;
 	};
 
 	struct GameResources {
 		ShaderRef quadShader;
-		ShaderRef postprocShader;
+		ShaderRef postprocShaders[POSTPROC_EFFECT_COUNT];	//permutation per effect - None's one is a plain copy, used to upscale the scene below native resolution
+		ShaderRef postprocShader;							//current effect's permutation
 
 		AtlasTextureRef atlas;
 		TextureRef background;
@@ -117,23 +179,42 @@ namespace Game {
 		FontRef fontSmall;
 
 		FramebufferRef fbo;
+		UniformBufferRef postprocParams;
 
+		Renderer::QuadLayerRef brickLayer;		//retained brick quads (rebuilt on level load)
+		std::vector<int> brickQuads;			//brick index -> index of its first quad in the layer
+
+		std::string levelsDir = "res/levels/";
 		std::vector<std::string> levelPaths;
 
 		std::map<std::string, Sound::AudioRef> sounds;
+
+		std::unique_ptr<RenderThread> renderThread;
 	};
 
 	static GameResources res;
 	static InGameState state;
+	static Simulation sim;
 
 	static char textbuf[256];
 
 	void DeltaTimeUpdate();
 	void RenderScene();
 	void GameUpdate();
-	void CollisionResolution();
-	void MidGame_Reset();
+	void GameTick();
+	void SimEventsProcessing();
+	void MidGame_Reset(bool fullReset = false);
 	void GameStateReset();
+	void InterpolationReset();
+	void BrickLayerRebuild();
+	void ReplayUpdate();
+	float ShakeRandom();
+	void ClearTarget(const FramebufferRef& fbo);
+	void SetPostprocEffect(int effect);
+	void PresentFrame();
+	void RenderStatsOverlay();
+	void DynamicResolutionUpdate();
+	glm::ivec2 SceneResolution();
 
 	void Transition_LoadLevel();
 	void Transition_BallLost();
@@ -152,21 +233,9 @@ namespace Game {
 	void Btn_Reset();
 	void Btn_Quit();
 
-	bool LoadLevel(const char* filepath);
-
 	bool MainMenu();
 	void Play();
 
-	//===== Collision handling =====
-
-	//Collision detection between two AABBs.
-	bool AABB_AABBCollision(const glm::vec2& aPos, const glm::vec2& aSize, const glm::vec2& bPos, const glm::vec2& bSize);
-	//Ball-wall collision detection & resolution.
-	//Returns true if ball touched the bottom wall -> player loses life.
-	bool WallsCollision();
-	bool Ball_PlatformCollision(glm::vec2& out_posFix, glm::vec2& out_newDir);
-	bool Ball_BrickCollision(const Brick& brick, glm::vec2& out_posFix, glm::vec2& out_newDir);
-
 	void RenderButton(const std::string& btnName, Button::ButtonCallbackType callback, const char* text, const glm::vec2& center, const glm::vec2& size, float fontScale, const ITextureRef& texture, const glm::vec4& fontColor = glm::vec4(1.f));
 	void RenderButton2(const std::string& btnName, Button::ButtonCallbackType callback, const char* text, 
 					   const glm::vec2& center, const glm::vec2& size, float fontScale, 
@@ -193,18 +262,52 @@ namespace Game {
 	}
 
 	void OnResizeCallback(int width, int height) {
-		res.fbo->Resize(width, height);
+		glm::ivec2 scene = SceneResolution();
+		Renderer::Enqueue([width, height, scene]() {
+			glViewport(0, 0, width, height);
+			res.fbo->Resize(width, height);
+			res.fbo->SetViewport(scene.x, scene.y);
+		});
 	}
 
 	//General initialization. Needs to be called before Run().
 	void Init() {
+		double initStart = glfwGetTime();
 		Window& window = Window::Get();
 		if (!window.IsInitialized()) {
-			window.Init(1200, 900, "Breakout");
+			window.Init(1200, 900, "Breakout", state.headless);
 		}
 
-		res.quadShader = Resources::TryGetShader("quads", "res/shaders/basic_quad_shader");
-		res.postprocShader = Resources::TryGetShader("postproc", "res/shaders/postproc_shader");
+		//nobody to press the keys
+		if (state.headless && state.controller == nullptr && state.replayMode != ReplayMode::Playback) {
+			LOG(LOG_INFO, "Headless run without a replay - enabling autoplay.\n");
+			SetAutoplay(true);
+		}
+
+		Renderer::SetBackend(state.softwareRenderer ? Renderer::Backend::Software : Renderer::Backend::OpenGL);
+
+		//shaders go first, so that their compilation overlaps with the rest of the loading
+		//(software backend doesn't use them - it's meant to work without any shader support from the driver)
+		if (!state.softwareRenderer) {
+			//without bindless textures (e.g. llvmpipe), the shaders sample from texture slots instead
+			std::vector<std::string> textureDefines;
+			if (Renderer::BindlessTextures()) {
+				textureDefines.push_back("BINDLESS_TEXTURES");
+			}
+			else {
+				LOG(LOG_INFO, "GL_ARB_bindless_texture is not supported by '%s' - textures are bound into slots.\n", glGetString(GL_RENDERER));
+			}
+
+			res.quadShader = Resources::TryGetShader("quads", "res/shaders/instanced_quad_shader.vert", "res/shaders/basic_quad_shader.frag", textureDefines);
+			//(None's permutation only upscales the scene - used when it's rendered at lower resolution)
+			for (int effect = 0; effect < POSTPROC_EFFECT_COUNT; effect++) {
+				std::string key = "postproc_" + std::to_string(effect);
+				std::vector<std::string> defines = textureDefines;
+				defines.push_back("EFFECT " + std::to_string(effect));
+				res.postprocShaders[effect] = Resources::TryGetShader(key, "res/shaders/instanced_quad_shader.vert", "res/shaders/postproc_shader.frag", defines);
+			}
+			res.postprocShader = res.postprocShaders[state.postproc.effect];
+		}
 		res.atlas = std::make_shared<AtlasTexture>("res/textures/atlas01.png", glm::ivec2(128, 128));
 		res.background = std::make_shared<Texture>("res/textures/background_ingame.png");
 		res.fontSmall = std::make_shared<Font>("res/fonts/PermanentMarker-Regular.ttf", 48);
@@ -219,29 +322,51 @@ namespace Game {
 		res.sounds["scratch"] = std::make_shared<Sound::Audio>("res/sounds/scratch3.mp3");
 
 		state.emission = ParticleSystem(BallEmission_ParticleUpdate, 100);
+		res.brickLayer = std::make_shared<Renderer::QuadLayer>();
 
-		srand((unsigned int)glfwGetTime());
+		//seed is stored with the recording, so that the (particle) RNG sequence can be reproduced
+		if (state.replayMode == ReplayMode::Playback) {
+			state.seed = state.replay.seed;
+		}
+		else {
+			state.seed = (uint32_t)time(nullptr);
+		}
 
 		TextureParams tParams = {};
 		tParams.wrapping = GL_REPEAT;
+		//allocated at native resolution, dynamic resolution only renders into its part
+		glm::ivec2 scene = SceneResolution();
 		res.fbo = std::make_shared<Framebuffer>(window.Width(), window.Height(), GL_RGBA, tParams);
+		res.fbo->SetViewport(scene.x, scene.y);
+		res.postprocParams = std::make_shared<UniformBuffer>(int(sizeof(PostprocParams)), POSTPROC_PARAMS_BINDING, &state.postproc);
 		window.SetResizeCallback(OnResizeCallback);
 
-		//load all level filepaths
-		try {
-			LOG(LOG_INFO, "Levels:\n");
-			for (auto& entry : std::filesystem::directory_iterator("res/levels/")) {
-				if (entry.path().extension() == ".txt") {
-					res.levelPaths.push_back(entry.path().string());
-					LOG(LOG_INFO, "\t%s\n", res.levelPaths.back().c_str());
+		//load all level filepaths (playback uses the recorded list)
+		if (state.replayMode == ReplayMode::Playback) {
+			res.levelPaths = state.replay.levels;
+		}
+		else {
+			try {
+				LOG(LOG_INFO, "Levels:\n");
+				for (auto& entry : std::filesystem::directory_iterator(res.levelsDir)) {
+					if (entry.path().extension() == ".txt") {
+						res.levelPaths.push_back(entry.path().string());
+						LOG(LOG_INFO, "\t%s\n", res.levelPaths.back().c_str());
+					}
 				}
 			}
-		}
-		catch (std::exception&) {
-			LOG(LOG_ERROR, "Levels directory not found.");
+			catch (std::exception&) {
+				LOG(LOG_ERROR, "Levels directory not found.");
+			}
 		}
 
+		Resources::WaitForShaders();
 		Renderer::SetShader(res.quadShader);
+		//dynamic resolution is driven by the pass timings
+		state.profiling |= (state.frameBudget_ms > 0.f);
+		if (state.profiling) {
+			Renderer::EnableProfiling(state.statsPath);
+		}
 
 		//setup input callbacks
 		glfwSetKeyCallback(window.Handle(), Ingame_KeyCallback);
@@ -249,14 +374,118 @@ namespace Game {
 
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		bool warmStart = !state.softwareRenderer;
+		for (int effect = 0; effect < POSTPROC_EFFECT_COUNT && warmStart; effect++) {
+			warmStart &= res.quadShader->FromCache() && res.postprocShaders[effect]->FromCache();
+		}
+		LOG(LOG_INFO, "Startup time: %.1f ms (%s start)\n", (glfwGetTime() - initStart) * 1e3, warmStart ? "warm" : "cold");
+	}
+
+	void SetTickRate(float ticksPerSecond) {
+		ASSERT_MSG(ticksPerSecond > 0.f, "Tick rate has to be positive.\n");
+		state.tickDelta = 1.f / ticksPerSecond;
+		LOG(LOG_INFO, "Simulation tick rate: %.1f Hz\n", ticksPerSecond);
+	}
+
+	void SetStressMode(int ballCount) {
+		state.stressBalls = ballCount;
+		LOG(LOG_INFO, "Stress mode: %d balls\n", ballCount);
+	}
+
+	void SetLevelsDirectory(const std::string& path) {
+		res.levelsDir = path;
+	}
+
+	void SetRecordingFile(const std::string& filepath) {
+		state.replayMode = ReplayMode::Record;
+		state.replayPath = filepath;
+		LOG(LOG_INFO, "Recording inputs into '%s'\n", filepath.c_str());
+	}
+
+	void SetAutoplay(bool enabled) {
+		state.controller = enabled ? std::make_shared<AutoPlayer>(AUTOPLAY_LAUNCH_DELAY_SEC) : nullptr;
+		LOG(LOG_INFO, "Autoplay: %s\n", enabled ? "on" : "off");
+	}
+
+	void SetRenderThread(bool enabled) {
+		state.useRenderThread = enabled;
+		LOG(LOG_INFO, "Render thread: %s\n", enabled ? "on" : "off");
+	}
+
+	void SetHeadless(bool enabled) {
+		state.headless = enabled;
+		LOG(LOG_INFO, "Headless: %s\n", enabled ? "on" : "off");
+	}
+
+	void SetSoftwareRenderer(bool enabled) {
+		state.softwareRenderer = enabled;
+		LOG(LOG_INFO, "Software renderer: %s\n", enabled ? "on" : "off");
+	}
+
+	void SetFrameLimit(int frames) {
+		state.frameLimit = frames;
+	}
+
+	void SetScreenshotFile(const std::string& filepath) {
+		state.screenshotPath = filepath;
+	}
+
+	void SetTraceFile(const std::string& filepath) {
+#ifdef BREAKOUT_TRACE
+		state.tracePath = filepath;
+		LOG(LOG_INFO, "Trace zones are written into '%s'\n", filepath.c_str());
+#else
+		LOG(LOG_WARN, "Tracing is compiled out (configure with -DBREAKOUT_TRACE=ON), '%s' won't be written.\n", filepath.c_str());
+#endif
+	}
+
+	void SetDynamicResolution(float frameBudget_ms) {
+		state.frameBudget_ms = std::max(frameBudget_ms, 0.f);
+		if (state.frameBudget_ms > 0.f) {
+			LOG(LOG_INFO, "Dynamic resolution: %.2f ms budget\n", state.frameBudget_ms);
+		}
+	}
+
+	void SetStatsOverlay(bool enabled) {
+		state.profiling |= enabled;
+		state.statsOverlay = enabled;
+	}
+
+	void SetStatsFile(const std::string& filepath) {
+		state.profiling = true;
+		state.statsPath = filepath;
+	}
+
+	bool SetReplayFile(const std::string& filepath) {
+		if (!state.replay.Load(filepath.c_str()))
+			return false;
+
+		state.replayMode = ReplayMode::Playback;
+		state.replayPath = filepath;
+		SetTickRate(state.replay.tickRate);
+		SetStressMode(state.replay.stressBalls);
+		return true;
 	}
 
 	void Run() {
+		TRACE_THREAD("Main");
 		Game::Init();
 
+		//GL context moves over to the render thread (until the end of the run)
+		if (state.useRenderThread) {
+			res.renderThread = std::make_unique<RenderThread>();
+		}
+		double runStart = glfwGetTime();
+
 		state.running = true;
 		while (!Window::Get().ShouldClose() && state.running) {
-			if (!MainMenu()) {
+			if (state.replayMode == ReplayMode::Playback || state.controller != nullptr) {
+				//straight into the game, without the menu
+				state.state = GameState::Playing;
+				state.menuState = MenuState::Play;
+			}
+			else if (!MainMenu()) {
 				//quit
 				Window::Get().Close();
 				state.running = false;
@@ -266,17 +495,40 @@ namespace Game {
 			Play();
 		}
 
+		//frame pacing report
+		double runTime = glfwGetTime() - runStart;
+		FrameTimings timings = (res.renderThread != nullptr) ? res.renderThread->Timings() : state.timings;
+		if (state.frames > 0 && timings.frames > 0) {
+			LOG(LOG_INFO, "Frames: %d, avg frame time: %.2f ms, avg latency (input -> swap): %.2f ms (%s)\n",
+				state.frames, 1e3 * runTime / state.frames, 1e3 * timings.latency_s / timings.frames, (res.renderThread != nullptr) ? "render thread" : "direct");
+		}
+		res.renderThread = nullptr;
+
+		if (!state.screenshotPath.empty()) {
+			Window::Get().SaveScreenshot(state.screenshotPath.c_str());
+		}
+
+#ifdef BREAKOUT_TRACE
+		if (!state.tracePath.empty()) {
+			Trace::Export(state.tracePath.c_str());
+		}
+#endif
 	}
 
 	void Release() {
 		res.background = nullptr;
 		res.quadShader = nullptr;
 		res.postprocShader = nullptr;
+		for (ShaderRef& shader : res.postprocShaders) {
+			shader = nullptr;
+		}
 		res.atlas = nullptr;
 
 		res.fontBig = nullptr;
 		res.fontSmall = nullptr;
 		res.fbo = nullptr;
+		res.postprocParams = nullptr;
+		res.brickLayer = nullptr;
 
 		res.levelPaths.clear();
 		res.sounds.clear();
@@ -293,10 +545,10 @@ namespace Game {
 
 		state.menuState = MenuState::Menu;
 
-		glClearColor(0.1f, 0.1f, 0.1f, 1.f);
 		while (!window.ShouldClose() && state.running && (state.state == GameState::MainMenu || state.state == GameState::Transition) && state.menuState != MenuState::Play) {
-			glClear(GL_COLOR_BUFFER_BIT);
-			Renderer::Begin();
+			state.frameStart = glfwGetTime();
+			ClearTarget(nullptr);
+			Renderer::Begin(false, "menu");
 			state.activeButtons.clear();
 
 			switch (state.menuState) {
@@ -322,8 +574,11 @@ namespace Game {
 					break;
 			}
 
+			if (state.statsOverlay) {
+				RenderStatsOverlay();
+			}
 			Renderer::End();
-			window.SwapBuffers();
+			PresentFrame();
 		}
 
 		return true;
@@ -331,14 +586,18 @@ namespace Game {
 
 	void TransitionLogic() {
 		if (state.transition_msg[0] != '\0') {
+			Renderer::SetLayer(SCENE_LAYER_MESSAGE);
 			Renderer::RenderText_Centered(res.fontSmall, state.transition_msg.c_str(), glm::vec2(0.f), 2.f, glm::vec4(1.f));
 		}
 
 		if (state.transition_keepBallMoving) {
-			state.b.pos += state.b.dir * state.b.speed * state.deltaTime;
+			for (Ball& b : sim.balls) {
+				b.pos += b.dir * b.speed * state.deltaTime;
+			}
 		}
 		if (state.transition_fadeIn) {
 			float alpha = 1.f - (glfwGetTime() - state.transition_startTime) / (state.transition_endTime - state.transition_startTime);
+			Renderer::SetLayer(SCENE_LAYER_FADE);
 			Renderer::RenderQuad(glm::vec3(0.f), glm::vec2(1.f), glm::vec4(glm::vec3(0.0f), alpha));
 		}
 
@@ -359,27 +618,53 @@ namespace Game {
 		//state.state = GameState::Playing;
 		DeltaTimeUpdate();
 
-		state.level = 0;
-		state.lives = STARTING_LIVES;
-		if (!LoadLevel(res.levelPaths[state.level].c_str())) {
+		//session start - same seed & tick counter for both recording and playback
+		srand(state.seed);
+		state.tick = 0;
+		state.launchRequested = false;
+		state.replayInput = {};
+		if (state.replayMode == ReplayMode::Record) {
+			state.replay.Begin(state.seed, 1.f / state.tickDelta, state.stressBalls, res.levelPaths);
+		}
+		else if (state.replayMode == ReplayMode::Playback) {
+			state.replay.Rewind();
+		}
+
+		sim.NewGame();
+		if (!sim.LoadLevel(res.levelPaths[sim.level].c_str())) {
 			throw std::exception();
 		}
+		BrickLayerRebuild();
 
 		GameStateReset();
 
-		glClearColor(0.1f, 0.1f, 0.1f, 1.f);
 		while (!window.ShouldClose() && state.running && state.state != GameState::MainMenu && state.menuState != MenuState::Menu) {
-			res.fbo->Bind();
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			Renderer::UseFBO(res.fbo);
+			state.frameStart = glfwGetTime();
+			DynamicResolutionUpdate();
+
+			//no effect at native resolution -> scene goes straight into the default framebuffer & the postprocessing pass is skipped
+			//(effect changes during the frame apply from the next one)
+			ShaderRef postprocShader = res.postprocShader;
+			int postprocEffect = state.postproc.effect;
+			bool postprocPass = (postprocEffect != 0 || state.renderScale < 1.f);
+			FramebufferRef sceneTarget = postprocPass ? res.fbo : nullptr;
+			ClearTarget(sceneTarget);
+
+			Renderer::UseFBO(sceneTarget);
 			Renderer::SetShader(res.quadShader);
-			Renderer::Begin();
+			Renderer::Begin(true, "scene");
 
 			state.activeButtons.clear();
 
 			DeltaTimeUpdate();
 			MousePosUpdate();
+			if (state.replayMode == ReplayMode::Playback) {
+				ReplayUpdate();
+			}
+			else if (state.controller != nullptr && state.state == GameState::EndScreen) {
+				//unattended run - start over
+				Btn_Reset();
+			}
 			
 			switch (state.state) {
 				case GameState::Playing:
@@ -399,19 +684,36 @@ namespace Game {
 			}
 			Renderer::End();
 
-			Framebuffer::Unbind();
-			glClear(GL_COLOR_BUFFER_BIT);
-			Renderer::UseFBO(nullptr);
-
 			//==== postprocessing render pass ====
-			Renderer::SetShader(res.postprocShader);
-			Renderer::Begin();
-			Renderer::RenderQuad(glm::vec3(0.f), glm::vec2(1.f), res.fbo->GetTexture());
-			Renderer::End();
+			if (postprocPass) {
+				ClearTarget(nullptr);
+				Renderer::UseFBO(nullptr);
+
+				//per-frame constants (copied - the frame might get replayed on the render thread)
+				PostprocParams params = state.postproc;
+				params.effect = postprocEffect;
+				params.uvScale = glm::vec2(SceneResolution()) / glm::vec2(window.Width(), window.Height());
+				if (Renderer::GetBackend() == Renderer::Backend::Software) {
+					Renderer::SetShader(res.quadShader);
+					Renderer::Begin(false, "postproc");
+					Renderer::SoftwarePostprocess(res.fbo, { params.shakeVec, params.offset, params.effect });
+					Renderer::End();
+				}
+				else {
+					Renderer::Enqueue([params]() {
+						res.postprocParams->Update(&params, int(sizeof(params)));
+					});
+
+					Renderer::SetShader(postprocShader);
+					Renderer::Begin(false, "postproc");
+					Renderer::RenderQuad(glm::vec3(0.f), glm::vec2(1.f), res.fbo->GetTexture());
+					Renderer::End();
+				}
+			}
 
 			//==== GUI render pass (done separately, so that post-processing isn't applied) ====
 			Renderer::SetShader(res.quadShader);
-			Renderer::Begin();
+			Renderer::Begin(false, "gui");
 			switch (state.state) {
 				case GameState::Paused:
 					RenderScene();
@@ -428,15 +730,14 @@ namespace Game {
 					RenderButton2("btn_game_quit", Btn_Quit, "Quit", glm::vec2(0.f, -0.3f), glm::vec2(0.2f, 0.07f), 1.f, res.atlas->GetTexture(0, 1), res.atlas->GetTexture(1, 1));
 					break;
 				case GameState::EndScreen:
-					state.effects.postprocEffect = PostProcEffectType::None;
-					res.postprocShader->Bind();
-					res.postprocShader->SetInt("effect", 0);
+					sim.effects.postprocEffect = PostProcEffectType::None;
+					SetPostprocEffect(0);
 					if (state.endScreen_gameWon) {
 						Renderer::RenderText_Centered(res.fontSmall, "You won!", glm::vec2(0.f, 0.3f), 2.f, glm::vec4(1.f));
 
-						snprintf(textbuf, sizeof(textbuf), "Levels cleared: %d", state.level);
+						snprintf(textbuf, sizeof(textbuf), "Levels cleared: %d", sim.level);
 						Renderer::RenderText_Centered(res.fontSmall, textbuf, glm::vec2(-0.3f, 0.1f), 1.f, glm::vec4(1.f));
-						snprintf(textbuf, sizeof(textbuf), "Lives remaining: %d", state.lives);
+						snprintf(textbuf, sizeof(textbuf), "Lives remaining: %d", sim.lives);
 						Renderer::RenderText_Centered(res.fontSmall, textbuf, glm::vec2(0.3f, 0.1f), 1.f, glm::vec4(1.f));
 
 						RenderButton2("btn_win_reset", Btn_Reset, "Play again", glm::vec2(0.f, -0.1f), glm::vec2(0.2f, 0.07f), 1.f, res.atlas->GetTexture(0, 1), res.atlas->GetTexture(1, 1));
@@ -446,7 +747,7 @@ namespace Game {
 					else {
 						Renderer::RenderText_Centered(res.fontSmall, "You lost!", glm::vec2(0.f, 0.3f), 2.f, glm::vec4(1.f));
 
-						snprintf(textbuf, sizeof(textbuf), "Levels cleared: %d", state.level);
+						snprintf(textbuf, sizeof(textbuf), "Levels cleared: %d", sim.level);
 						Renderer::RenderText_Centered(res.fontSmall, textbuf, glm::vec2(0.0f, 0.1f), 1.f, glm::vec4(1.f));
 
 						RenderButton2("btn_lost_reset", Btn_Reset, "Play again", glm::vec2(0.f, -0.1f), glm::vec2(0.2f, 0.07f), 1.f, res.atlas->GetTexture(0, 1), res.atlas->GetTexture(1, 1));
@@ -455,9 +756,29 @@ namespace Game {
 					}
 					break;
 			}
+			if (state.statsOverlay) {
+				RenderStatsOverlay();
+			}
 			Renderer::End();
 
-			window.SwapBuffers();
+			PresentFrame();
+		}
+
+		if (state.replayMode == ReplayMode::Record) {
+			state.replay.End(state.tick);
+			state.replay.Save(state.replayPath.c_str());
+		}
+	}
+
+	//Playback flow control - game resets outside of the ticks (end screen, ingame menu) & end of the recording.
+	void ReplayUpdate() {
+		if (state.replay.PopNewGame(state.tick)) {
+			Btn_Reset();
+		}
+
+		if (state.replay.Finished(state.tick)) {
+			LOG(LOG_INFO, "Replay finished (%d ticks, %.2f s simulated).\n", (int)state.tick, sim.Time());
+			Btn_Quit();
 		}
 	}
 
@@ -499,8 +820,12 @@ namespace Game {
 	}
 
 	void Btn_Reset() {
-		state.level = 0;
-		state.lives = STARTING_LIVES;
+		if (state.replayMode == ReplayMode::Record) {
+			state.replay.RecordEvent(state.tick, InputEventType::NewGame);
+		}
+		state.launchRequested = false;
+
+		sim.NewGame();
 		Transition_LoadLevel();
 		GameStateReset();
 		//state.state = GameState::Playing;
@@ -519,60 +844,87 @@ namespace Game {
 		state.running = false;
 	}
 
-	void MidGame_Reset() {
-		state.p.pos = 0.f;
-		state.b.pos = glm::vec2(state.p.pos, PLATFORM_Y_POS + PLATFORM_HEIGHT + state.b.radius);
-		state.b.dir = glm::vec2(0.0f, 1.f);
-		state.b.onPlatform = true;
-
-		state.effects.wallBreaker = false;
-		state.effects.platformSticking = false;
-		if (state.effects.postprocEffect != PostProcEffectType::None) {
-			res.postprocShader->Bind();
-			res.postprocShader->SetInt("effect", 0);
-			state.effects.postprocEffect = PostProcEffectType::None;
+	//Full reset also restores ball & platform properties (sim.Reset() includes the mid-game reset).
+	void MidGame_Reset(bool fullReset) {
+		if (sim.effects.postprocEffect != PostProcEffectType::None) {
+			SetPostprocEffect(0);
 		}
+		if (fullReset)
+			sim.Reset();
+		else
+			sim.MidGameReset();
 
 		state.emission.Reset();
+		state.emissionOffset = 0;
+		InterpolationReset();
+		state.stressPending = (state.stressBalls > 0);
+		state.launchRequested = false;
 	}
 
 	void GameStateReset() {
-		state.b.speed = DEFAULT_BALL_SPEED;
-		state.p.speed = DEFAULT_PLATFORM_SPEED;
-		state.p.scale = DEFAULT_PLATFORM_SCALE;
+		MidGame_Reset(true);
+	}
 
-		MidGame_Reset();
+	//Drops the previous tick state, so that teleported objects don't get interpolated.
+	void InterpolationReset() {
+		for (Ball& b : sim.balls) {
+			b.prevPos = b.pos;
+		}
+		state.prevPlatformPos = sim.p.pos;
+		state.tickAccumulator = 0.f;
+		state.renderAlpha = 1.f;
+	}
+
+	//Brick quads (base + type overlay) for the whole level, in a single GPU-resident layer.
+	void BrickLayerRebuild() {
+		res.brickLayer->Clear();
+		res.brickQuads.assign(sim.bricks.Size(), -1);
+
+		sim.bricks.ForEachAlive([](int i) {
+			glm::vec2 pos = sim.bricks.Position(i, sim.brickSize);
+			int type = sim.bricks.type[i];
+			int color = sim.bricks.color[i];
+
+			res.brickQuads[i] = res.brickLayer->Add(glm::vec3(pos, 0.f), glm::vec2(sim.brickSize), res.atlas->GetTexture(color, 0));
+			if (type != BrickType::Brick) {
+				glm::ivec2 tc = BrickType::GetTypeTexCoord(type, color);
+				res.brickLayer->Add(glm::vec3(pos, 0.f), glm::vec2(sim.brickSize), res.atlas->GetTexture(tc.x, tc.y));
+			}
+		});
 	}
 
 	void RenderScene() {
+		//interpolate between the last two ticks (ball moves per frame during transitions)
+		float alpha = (state.state == GameState::Transition) ? 1.f : state.renderAlpha;
+		float platformPos = glm::mix(state.prevPlatformPos, sim.p.pos, alpha);
+		Renderer::SetLayer(SCENE_LAYER_MAIN);
+
 		//background texture
 		//Renderer::RenderQuad(glm::vec3(0.f, 0.f, 1.f), glm::vec2(1.f), res.background);
 
 		//ball emission
-		state.emission.Render();
+		state.emission.Render(alpha);
 
 		//platform
-		Renderer::RenderQuad(glm::vec3(state.p.pos, PLATFORM_Y_POS, 0.f), glm::vec2(state.p.scale, PLATFORM_HEIGHT), glm::vec4(glm::vec3(0.3f), 1.f));
-		Renderer::RenderQuad(glm::vec3(state.p.pos, PLATFORM_Y_POS, 0.f), glm::vec2(state.p.scale, PLATFORM_HEIGHT) - 0.01f, glm::vec4(glm::vec3(0.7f), 1.f));
-
-		//bricks
-		for (Brick& b : state.bricks) {
-			/*Renderer::RenderQuad(glm::vec3(b.pos, 0.f), glm::vec2(state.brickSize), glm::vec4(1.f, 0.f, 0.f, 1.f));*/
-			Renderer::RenderQuad(glm::vec3(b.pos, 0.f), glm::vec2(state.brickSize), res.atlas->GetTexture(b.color, 0));
-			if (b.type != BrickType::Brick) {
-				Renderer::RenderQuad(glm::vec3(b.pos, 0.f), glm::vec2(state.brickSize), res.atlas->GetTexture(b.tc.x, b.tc.y));
-			}
+		Renderer::RenderQuad(glm::vec3(platformPos, PLATFORM_Y_POS, 0.f), glm::vec2(sim.p.scale, PLATFORM_HEIGHT), glm::vec4(glm::vec3(0.3f), 1.f));
+		Renderer::RenderQuad(glm::vec3(platformPos, PLATFORM_Y_POS, 0.f), glm::vec2(sim.p.scale, PLATFORM_HEIGHT) - 0.01f, glm::vec4(glm::vec3(0.7f), 1.f));
+
+		//bricks (retained layer, patched as the bricks get destroyed)
+		Renderer::RenderLayer(*res.brickLayer);
+
+		//balls
+		const ITextureRef& ballTexture = res.atlas->GetTexture(0, 0);
+		float aspectRatio = Window::Get().AspectRatio();
+		for (const Ball& b : sim.balls) {
+			glm::vec2 ballPos = glm::mix(b.prevPos, b.pos, alpha);
+			Renderer::RenderQuad(glm::vec3(ballPos, 0.f), glm::vec2(b.radius / aspectRatio, b.radius), ballTexture);
 		}
 
-		//ball
-		glm::vec2 ballSize = glm::vec2(state.b.radius / Window::Get().AspectRatio(), state.b.radius);
-		Renderer::RenderQuad(glm::vec3(state.b.pos, 0.f), ballSize, res.atlas->GetTexture(0, 0));
-
 		//texts
-		snprintf(textbuf, sizeof(textbuf), "Lives: %d", state.lives);
+		snprintf(textbuf, sizeof(textbuf), "Lives: %d", sim.lives);
 		Renderer::RenderText(res.fontSmall, textbuf, glm::vec2(-0.95f, 0.9f), 1.f, glm::vec4(1.f));
 
-		snprintf(textbuf, sizeof(textbuf), "Level: %d", state.level + 1);
+		snprintf(textbuf, sizeof(textbuf), "Level: %d", sim.level + 1);
 		Renderer::RenderText(res.fontSmall, textbuf, glm::vec2(-0.95f, 0.8f), 1.f, glm::vec4(1.f));
 
 		
@@ -581,223 +933,264 @@ namespace Game {
 	}
 
 	void GameUpdate() {
-		float prevPos = state.p.pos;
-
-		//ball emission update
-		state.emission.Update(state.deltaTime);
-
-		if (state.effects.postprocEffect == PostProcEffectType::Blur) {
-			res.postprocShader->Bind();
-			res.postprocShader->SetFloat("offset", 3.f / float(Window::Get().Height()));
-			res.postprocShader->SetVec2("shakeVec", glm::normalize(glm::vec2(float(rand() * 2.f - 1.f) / RAND_MAX, float(rand() * 2.f - 1.f) / RAND_MAX)) * (0.1f * float(rand()) / RAND_MAX));
+		TRACE_ZONE("GameUpdate");
+		if (sim.effects.postprocEffect == PostProcEffectType::Blur) {
+			state.postproc.offset = 3.f / float(Window::Get().Height());
+			state.postproc.shakeVec = glm::normalize(glm::vec2(ShakeRandom() * 2.f - 1.f, ShakeRandom() * 2.f - 1.f)) * (0.1f * ShakeRandom());
 		}
-		else if (state.effects.postprocEffect == PostProcEffectType::Drunk) {
-			res.postprocShader->Bind();
-			res.postprocShader->SetFloat("offset", 3.f * (1.f + (float(rand()) / RAND_MAX) * 2.f) / float(Window::Get().Height()));
-			res.postprocShader->SetVec2("shakeVec", glm::vec2(0.f));
+		else if (sim.effects.postprocEffect == PostProcEffectType::Drunk) {
+			state.postproc.offset = 3.f * (1.f + ShakeRandom() * 2.f) / float(Window::Get().Height());
+			state.postproc.shakeVec = glm::vec2(0.f);
 		}
 
-		//input processing - platform movement
-		if (state.state == GameState::Playing && (state.inputs.left || state.inputs.right)) {
-			float move = (float(state.inputs.right) - float(state.inputs.left)) * state.p.speed;
-			state.p.pos += move * state.deltaTime;
-
-			//platform movement clamping
-			if (state.p.pos < -0.98f + state.p.scale)
-				state.p.pos = -0.98f + state.p.scale;
-			if (state.p.pos > 0.98f - state.p.scale)
-				state.p.pos = 0.98f - state.p.scale;
+		//fixed-step simulation - run as many ticks as fit into the elapsed time, the rest carries over to the next frame
+		state.tickAccumulator += state.deltaTime;
+		while (state.tickAccumulator >= state.tickDelta && state.state == GameState::Playing) {
+			state.tickAccumulator -= state.tickDelta;
+			GameTick();
 		}
-		
-		//ball update
-		if (state.b.onPlatform) {
-			//stick to the platform
-			float ballXOffset = state.b.pos.x - prevPos;
-			state.b.pos = glm::vec2(state.p.pos + ballXOffset, PLATFORM_Y_POS + PLATFORM_HEIGHT + state.b.radius);
+		state.renderAlpha = glm::clamp(state.tickAccumulator / state.tickDelta, 0.f, 1.f);
+	}
+
+	//Per-frame effects randomness. Kept apart from rand(), which has to follow the ticks (to be reproducible from the seed).
+	float ShakeRandom() {
+		static uint32_t x = 0x9E3779B9u;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return float(x >> 8) / float(1 << 24);
+	}
+
+	//Single simulation step (ball emission included).
+	void GameTick() {
+		SimInput input = {};
+		bool launch = false;
+
+		//inputs - either live (keyboard or controller, recorded) or from the recording
+		if (state.replayMode == ReplayMode::Playback) {
+			if (state.replay.PopNewGame(state.tick)) {
+				Btn_Reset();
+				return;
+			}
+			state.replay.PlaybackTick(state.tick, state.replayInput, launch);
+			input = state.replayInput;
 		}
 		else {
-			//ball movement
-			state.b.pos += state.b.dir * state.b.speed * state.deltaTime;
+			if (state.controller != nullptr) {
+				state.controller->Update(sim, state.tickDelta, input, launch);
+			}
+			else {
+				input.left = state.inputs.left;
+				input.right = state.inputs.right;
+				launch = state.launchRequested;
+			}
+			state.launchRequested = false;
 
-			//collision detection & resolution
-			CollisionResolution();
+			if (state.replayMode == ReplayMode::Record) {
+				state.replay.RecordTick(state.tick, input, launch);
+			}
 		}
 
-		state.bricksLeft = 0;
-		for (Brick& b : state.bricks) {
-			if (b.type == BrickType::Brick)
-				state.bricksLeft++;
+		if (launch) {
+			if (state.stressPending) {
+				sim.SpawnBalls(state.stressBalls);
+				state.stressPending = false;
+			}
+			sim.LaunchBall();
 		}
 
-		//level finished condition check
-		if (state.bricksLeft < 1) {
-			state.level++;
-			state.transition_keepBallMoving = true;
-			state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
-			state.state = GameState::Transition;
-			state.transition_msg = "Level finished!";
-			state.TransitionHandler = Transition_LoadLevel;
-			state.transition_fadeIn = false;
-		}
-	}
+		state.prevPlatformPos = sim.p.pos;
+
+		//ball emission update
+		state.emission.Update(state.tickDelta);
 
-	void CollisionResolution() {
-		glm::vec2 ballSize = glm::vec2(state.b.radius);
-		std::vector<int> bricksDeleteIdx;
-		glm::vec2 posFix, newDir;
+		sim.Update(state.tickDelta, input);
+		SimEventsProcessing();
+		state.tick++;
+	}
 
-		//collisions with bricks
-		for(int i = 0; i < int(state.bricks.size()); i++) {
-#if 0
-			if(AABB_AABBCollision(state.b.pos, ballSize, state.bricks[i].pos, state.brickSize)) {
-				bricksDeleteIdx.push_back(i);
-				break;
+	//Translates simulation events into sounds, postprocessing changes & game state transitions.
+	void SimEventsProcessing() {
+		//with many balls, there can be loads of hits per step -> each sound plays only once
+		int played = 0;
+		auto PlayOnce = [&played](SimEventType type, const char* sound) {
+			if ((played & BIT(int(type))) == 0) {
+				played |= BIT(int(type));
+				Sound::Play(res.sounds[sound]);
 			}
-#else
-			if (Ball_BrickCollision(state.bricks[i], posFix, newDir)) {
-				bool bounce = false;
-
-				switch (state.bricks[i].type) {
-					default:
-					case BrickType::Brick:
-						Sound::Play(res.sounds["solid"]);
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::Wall:
-						Sound::Play(res.sounds["solid"]);
-						if (state.effects.wallBreaker) {
-							bricksDeleteIdx.push_back(i);
-						}
-						bounce = true;
-						break;
-					case BrickType::PlatformGrow:
-						Sound::Play(res.sounds["powerup"]);
-						state.p.scale *= 2.f;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::PlatformShrink:
-						Sound::Play(res.sounds["powerup"]);
-						state.p.scale *= 0.5f;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::PlatformSticking:
-						Sound::Play(res.sounds["powerup"]);
-						state.effects.platformSticking = true;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::WallBreaker:
-						Sound::Play(res.sounds["powerup"]);
-						state.effects.wallBreaker = true;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::BallSpeedUp:
-						Sound::Play(res.sounds["powerup"]);
-						state.b.speed *= 1.5f;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::BallSlowDown:
-						Sound::Play(res.sounds["powerup"]);
-						state.b.speed *= 0.666666f;
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::EffectBlur:
-						Sound::Play(res.sounds["bleep"]);
-						state.effects.postprocEffect = PostProcEffectType::Blur;
-						res.postprocShader->Bind();
-						res.postprocShader->SetInt("effect", 1);
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::EffectDrunk:
-						Sound::Play(res.sounds["bleep"]);
-						state.effects.postprocEffect = PostProcEffectType::Drunk;
-						res.postprocShader->Bind();
-						res.postprocShader->SetInt("effect", 2);
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::EffectChaos:
-						Sound::Play(res.sounds["bleep"]);
-						state.effects.postprocEffect = PostProcEffectType::Chaos;
-						res.postprocShader->Bind();
-						res.postprocShader->SetInt("effect", 3);
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-					case BrickType::EffectConfuse:
-						Sound::Play(res.sounds["bleep"]);
-						state.effects.postprocEffect = PostProcEffectType::Confuse;
-						res.postprocShader->Bind();
-						res.postprocShader->SetInt("effect", 4);
-						bricksDeleteIdx.push_back(i);
-						bounce = true;
-						break;
-				}
+		};
 
-				if (bounce) {
-					//fix ball's position and change direction (bounce)
-					state.b.pos += posFix;
-					state.b.dir = newDir;
+		for (const SimEvent& e : sim.Events()) {
+			switch (e.type) {
+				case SimEventType::BrickHit:
+					PlayOnce(e.type, "solid");
+					break;
+				case SimEventType::PowerUp:
+					PlayOnce(e.type, "powerup");
+					break;
+				case SimEventType::EffectChange:
+					PlayOnce(e.type, "bleep");
+					SetPostprocEffect(e.value);
+					break;
+				case SimEventType::PlatformHit:
+					PlayOnce(e.type, "bang");
+					break;
+				case SimEventType::BrickDestroyed:
+				{
+					int quadIdx = res.brickQuads[e.value];
+					res.brickLayer->Remove(quadIdx);
+					if (sim.bricks.type[e.value] != BrickType::Brick) {
+						res.brickLayer->Remove(quadIdx + 1);
+					}
+					break;
 				}
+				case SimEventType::GameOver:
+					state.transition_nextState = GameState::EndScreen;
+					state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
+					state.transition_keepBallMoving = true;
+					state.transition_msg = "Game over!";
+					state.TransitionHandler = nullptr;
+					state.transition_fadeIn = false;
+					state.endScreen_gameWon = false;
+
+					state.state = GameState::Transition;
+					Sound::Play(res.sounds["lose"]);
+					LOG(LOG_INFO, "Ball lost. Game over.\n");
+					break;
+				case SimEventType::BallLost:
+					state.transition_nextState = GameState::Playing;
+					state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
+					state.transition_keepBallMoving = true;
+					state.transition_msg = "Ball lost!";
+					state.TransitionHandler = Transition_BallLost;
+					state.transition_fadeIn = false;
+
+					state.state = GameState::Transition;
+					Sound::Play(res.sounds["scratch"]);
+					LOG(LOG_INFO, "Ball lost. Remaining lives: %d\n", e.value);
+					break;
+				case SimEventType::LevelFinished:
+					state.transition_keepBallMoving = true;
+					state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
+					state.state = GameState::Transition;
+					state.transition_msg = "Level finished!";
+					state.TransitionHandler = Transition_LoadLevel;
+					state.transition_fadeIn = false;
+					break;
+			}
+		}
+	}
 
-				//if (isnan(state.b.pos.x) || isnan(state.b.pos.y)) { __debugbreak(); }
+	//Clears given render target (default framebuffer, if null).
+	void ClearTarget(const FramebufferRef& fbo) {
+		Renderer::Clear(fbo, glm::vec4(0.1f, 0.1f, 0.1f, 1.f));
+	}
 
-				break;
-			}
-#endif
+	//Switches the postprocessing shader permutation (None's one is only used for upscaling - the pass is bypassed at native resolution).
+	void SetPostprocEffect(int effect) {
+		ASSERT(effect >= 0 && effect < POSTPROC_EFFECT_COUNT);
+		state.postproc.effect = effect;
+		res.postprocShader = res.postprocShaders[effect];
+	}
+
+	//Ends the frame - swaps the buffers right away, or hands the recorded frame over to the render thread.
+	void PresentFrame() {
+		Window& window = Window::Get();
+		Renderer::EndFrame();
+		if (res.renderThread != nullptr) {
+			res.renderThread->SubmitFrame(state.frameStart);
+		}
+		else {
+			window.Present();
+			state.timings.frames++;
+			state.timings.latency_s += glfwGetTime() - state.frameStart;
 		}
+		state.frames++;
+		window.PollEvents();
 
-		//delete marked bricks
-		for (auto it = bricksDeleteIdx.rbegin(); it != bricksDeleteIdx.rend(); ++it) {
-			state.bricks.erase(state.bricks.begin() + *it);
+		if (state.frameLimit > 0 && state.frames >= state.frameLimit) {
+			Btn_Quit();
 		}
+	}
 
-		//collision with platform
-		if (Ball_PlatformCollision(posFix, newDir)) {
-			state.b.pos += posFix;
-			state.b.dir = newDir;
-			if (state.effects.platformSticking) {
-				state.b.onPlatform = true;
-			}
-			Sound::Play(res.sounds["bang"]);
+	//Per-pass stats of the last resolved frame (lags a few frames behind, GPU timings are read without stalling).
+	void RenderStatsOverlay() {
+		Renderer::FrameStats frame = Renderer::LastFrameStats();
+		if (frame.frame < 0)
+			return;
+
+		constexpr float scale = 0.35f;
+		constexpr float lineHeight = 0.045f;
+		glm::vec2 pos = glm::vec2(-0.98f, 0.94f);
+		glm::vec4 color = glm::vec4(1.f, 1.f, 0.6f, 1.f);
+
+		snprintf(textbuf, sizeof(textbuf), "frame %d | pass: cpu ms, gpu ms, draws, quads, flushes (full/shader/order/tex/end), KB", frame.frame);
+		Renderer::RenderText(res.fontSmall, textbuf, pos, scale, color);
+
+		for (const Renderer::PassStats& pass : frame.passes) {
+			const Renderer::RendererStats& s = pass.stats;
+			pos.y -= lineHeight;
+			snprintf(textbuf, sizeof(textbuf), "%s: %.2f, %.2f, %d, %d, %d/%d/%d/%d/%d, %.1f", pass.name, pass.cpuTime_ms, pass.gpuTime_ms, s.drawCalls, s.quads,
+				s.flushes[Renderer::Flush_BatchFull], s.flushes[Renderer::Flush_Shader], s.flushes[Renderer::Flush_Order], s.flushes[Renderer::Flush_Textures], s.flushes[Renderer::Flush_Explicit], s.bytesUploaded / 1024.0);
+			Renderer::RenderText(res.fontSmall, textbuf, pos, scale, color);
 		}
 
-		//collisions with walls (left/top/right -> bounce, bottom -> lose)
-		if (WallsCollision()) {
-			if ((--state.lives) <= 0) {
-				state.transition_nextState = GameState::EndScreen;
-				state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
-				state.transition_keepBallMoving = true;
-				state.transition_msg = "Game over!";
-				state.TransitionHandler = nullptr;
-				state.transition_fadeIn = false;
-				state.endScreen_gameWon = false;
-
-				state.state = GameState::Transition;
-				Sound::Play(res.sounds["lose"]);
-				LOG(LOG_INFO, "Ball lost. Game over.\n");
-			}
-			else {
-				state.transition_nextState = GameState::Playing;
-				state.transition_endTime = glfwGetTime() + RESET_DELAY_SEC;
-				state.transition_keepBallMoving = true;
-				state.transition_msg = "Ball lost!";
-				state.TransitionHandler = Transition_BallLost;
-				state.transition_fadeIn = false;
-
-				state.state = GameState::Transition;
-				Sound::Play(res.sounds["scratch"]);
-				LOG(LOG_INFO, "Ball lost. Remaining lives: %d\n", state.lives);
-			}
+		if (state.frameBudget_ms > 0.f) {
+			pos.y -= lineHeight;
+			snprintf(textbuf, sizeof(textbuf), "scene resolution: %d%% (cost %.2f / %.2f ms)", int(state.renderScale * 100.f + 0.5f), state.frameCost_ms, state.frameBudget_ms);
+			Renderer::RenderText(res.fontSmall, textbuf, pos, scale, color);
+		}
+	}
+
+	//Picks the scene's resolution scale from the profiled frame cost (GPU time, or CPU time of the passes, if that's longer).
+	//Cost can't exceed the budget -> scale goes down; with enough headroom it goes back up. Changes are spaced out, so that the frame
+	//cost settles first (timings arrive few frames late).
+	void DynamicResolutionUpdate() {
+		if (state.frameBudget_ms <= 0.f)
+			return;
+
+		Renderer::FrameStats frame = Renderer::LastFrameStats();
+		if (frame.frame < 0 || frame.frame == state.scaledFrame)
+			return;
+		state.scaledFrame = frame.frame;
+
+		double cost = 0.0;
+		for (const Renderer::PassStats& pass : frame.passes) {
+			cost += std::max(pass.cpuTime_ms, pass.gpuTime_ms);
 		}
+		state.frameCost_ms = (state.frameCost_ms > 0.0) ? glm::mix(state.frameCost_ms, cost, double(DYNRES_SMOOTHING)) : cost;
 
+		if (state.scaleCooldown > 0) {
+			state.scaleCooldown--;
+			return;
+		}
+
+		float scale = state.renderScale;
+		if (state.frameCost_ms > state.frameBudget_ms) {
+			scale -= DYNRES_STEP;
+		}
+		else if (state.frameCost_ms < state.frameBudget_ms * DYNRES_HEADROOM) {
+			scale += DYNRES_STEP;
+		}
+		scale = glm::clamp(std::round(scale / DYNRES_STEP) * DYNRES_STEP, DYNRES_MIN_SCALE, 1.f);
+		if (scale == state.renderScale)
+			return;
+
+		state.renderScale = scale;
+		state.scaleCooldown = DYNRES_COOLDOWN;
+		state.frameCost_ms = 0.0;
+
+		//no reallocation - the scene is rendered into a smaller part of the framebuffer (postproc scales the UVs to match)
+		glm::ivec2 scene = SceneResolution();
+		Renderer::Enqueue([scene]() {
+			res.fbo->SetViewport(scene.x, scene.y);
+		});
+	}
+
+	//Scene's resolution (window's resolution scaled by the dynamic resolution) - viewport within the scene framebuffer.
+	glm::ivec2 SceneResolution() {
+		Window& window = Window::Get();
+		return glm::max(glm::ivec2(glm::round(glm::vec2(window.Width(), window.Height()) * state.renderScale)), glm::ivec2(1));
 	}
 
 	void DeltaTimeUpdate() {
@@ -835,7 +1228,7 @@ namespace Game {
 				}
 				break;
 			case GLFW_KEY_ESCAPE:	//ingame menu
-				if (action == GLFW_PRESS) {
+				if (action == GLFW_PRESS && state.replayMode != ReplayMode::Playback) {
 					if (state.state == GameState::Playing)
 						state.state = GameState::IngameMenu;
 					else if (state.state == GameState::IngameMenu)
@@ -845,9 +1238,14 @@ namespace Game {
 			case GLFW_KEY_ENTER:	//menu controls - button click
 
 				break;
-			case GLFW_KEY_SPACE:	//fire the ball
-				if (action == GLFW_PRESS && state.b.onPlatform) {
-					state.b.onPlatform = false;
+			case GLFW_KEY_SPACE:	//fire the ball (on the next tick)
+				if (action == GLFW_PRESS && state.state == GameState::Playing) {
+					state.launchRequested = true;
+				}
+				break;
+			case GLFW_KEY_F3:		//renderer stats overlay
+				if (action == GLFW_PRESS && state.profiling) {
+					state.statsOverlay = !state.statsOverlay;
 				}
 				break;
 		}
@@ -867,115 +1265,6 @@ namespace Game {
 		}
 	}
 
-	//===== Collision handling =====
-
-	//Collision detection between two AABBs.
-	bool AABB_AABBCollision(const glm::vec2& aPos, const glm::vec2& aSize, const glm::vec2& bPos, const glm::vec2& bSize) {
-		glm::vec2 aMin = aPos - aSize;
-		glm::vec2 aMax = aPos + aSize;
-		glm::vec2 bMin = bPos - bSize;
-		glm::vec2 bMax = bPos + bSize;
-
-		bool xCheck = (aMin.x < bMax.x) && (aMax.x > bMin.x);
-		bool yCheck = (aMin.y < bMax.y) && (aMax.y > bMin.y);
-
-		return (xCheck && yCheck);
-	}
-
-	//Ball-wall collision detection & resolution.
-	//Returns true if ball touched the bottom wall -> player loses life.
-	bool WallsCollision() {
-		glm::vec2 bMin = state.b.pos - state.b.radius;
-		glm::vec2 bMax = state.b.pos + state.b.radius;
-
-		if (bMin.x <= -1.f || bMax.x >= 1.f) {
-			state.b.dir.x = -state.b.dir.x;
-		}
-		else if (bMax.y >= 1.f) {
-			state.b.dir.y = -state.b.dir.y;
-		}
-		else if (bMin.y <= -1.f) {
-			return true;
-		}
-
-		return false;
-	}
-
-	bool Ball_PlatformCollision(glm::vec2& out_posFix, glm::vec2& out_newDir) {
-		glm::vec2 pMin = glm::vec2(state.p.pos - state.p.scale, PLATFORM_Y_POS - PLATFORM_HEIGHT);
-		glm::vec2 pMax = glm::vec2(state.p.pos + state.p.scale, PLATFORM_Y_POS + PLATFORM_HEIGHT);
-
-		glm::vec2 P = glm::clamp(state.b.pos, pMin, pMax);
-		float dist = glm::distance(P, state.b.pos);
-		if (dist < state.b.radius) {
-			//compute position fix vector
-			glm::vec2 a = (P - state.b.pos);
-			glm::vec2 b = a * (state.b.radius / dist);
-			out_posFix = a - b;
-
-			////new direction -> based on distance from platform's center
-			//out_newDir = state.b.dir;
-			//if (P.x == pMin.x || P.x == pMax.x) {
-			//	//collision with left/right side of brick
-			//	out_newDir.x = -out_newDir.x;
-			//}
-			//else {
-			//	//collision with top/bottom side of brick
-			//	out_newDir.y = -out_newDir.y;
-			//}
-			////float f = 0.5f + (fabsf(P.x - state.p.pos) / state.p.scale);
-			////out_newDir.x *= f;
-			////out_newDir = glm::normalize(out_newDir);
-
-			float f = ((P.x - state.p.pos) / state.p.scale) * PLATFORM_BOUNCE_STEEPNESS;
-			out_newDir = glm::normalize(glm::vec2(f, 1.f));
-
-			//printf("%.2f\n", f);
-
-			return true;
-		}
-
-		return false;
-	}
-
-	bool Ball_BrickCollision(const Brick& brick, glm::vec2& out_posFix, glm::vec2& out_newDir) {
-		glm::vec2 brickMin = brick.pos - state.brickSize;
-		glm::vec2 brickMax = brick.pos + state.brickSize;
-
-		glm::vec2 P = glm::clamp(state.b.pos, brickMin, brickMax);
-
-		float dist = glm::distance(P, state.b.pos);
-		if (dist < state.b.radius) {
-			//compute position fix vector
-			glm::vec2 a = (P - state.b.pos);
-			if (dist > 1e-3f) {
-				glm::vec2 b = a * (state.b.radius / dist);
-				out_posFix = a - b;
-			}
-			else {
-				out_posFix = a;
-			}
-
-			//glm::vec2 N = ...;
-			//out_newDir = glm::normalize(state.b.dir - 2.f * glm::dot(state.b.dir, N) * N);
-
-			//compute bounce direction
-			out_newDir = state.b.dir;
-			if (P.x == brickMin.x || P.x == brickMax.x) {
-				//collision with left/right side of brick
-				out_newDir.x = -out_newDir.x;
-			}
-			else {
-				//collision with top/bottom side of brick
-				out_newDir.y = -out_newDir.y;
-			}
-
-			return true;
-		}
-		else
-			return false;
-	}
-
 	void RenderButton(const std::string& btnName, Button::ButtonCallbackType callback, const char* text, const glm::vec2& center, const glm::vec2& size, float fontScale, const ITextureRef& texture, const glm::vec4& fontColor) {
 		Renderer::RenderQuad(glm::vec3(center, 0.f), size, texture);
 		state.activeButtons.push_back(Button(btnName, Renderer::GetLastQuad(), callback));
@@ -999,17 +1288,18 @@ namespace Game {
 	}
 
 	void Transition_LoadLevel() {
-		if (res.levelPaths.size() <= state.level) {
+		if (res.levelPaths.size() <= sim.level) {
 			//no more levels -> game finished
 			state.endScreen_gameWon = true;
 			state.state = GameState::EndScreen;
 		}
 		else {
 			//load next level & reset state
-			if (!LoadLevel(res.levelPaths[state.level].c_str())) {
-				LOG(LOG_WARN, "Level loading error ('%s').\n", res.levelPaths[state.level].c_str());
+			if (!sim.LoadLevel(res.levelPaths[sim.level].c_str())) {
+				LOG(LOG_WARN, "Level loading error ('%s').\n", res.levelPaths[sim.level].c_str());
 				throw std::exception();
 			}
+			BrickLayerRebuild();
 			GameStateReset();
 			state.state = GameState::Playing;
 		}
@@ -1028,118 +1318,12 @@ namespace Game {
 		double x = state.inputs.mouseX;
 		double y = state.inputs.mouseY;
 
-		glm::vec2 bMin = glm::vec2(quad.vertices[0].position);
-		glm::vec2 bMax = glm::vec2(quad.vertices[3].position);
+		glm::vec2 bMin = quad.Corner(0);
+		glm::vec2 bMax = quad.Corner(3);
 
 		return (x >= bMin.x && x <= bMax.x && y >= bMin.y && y <= bMax.y);
 	}
 
-	bool LoadLevel(const char* filepath) {
-		//load level description file
-		std::string levelDesc;
-		if (!TryReadFile(filepath, levelDesc)) {
-			LOG(LOG_ERROR, "Level loading failed.\n");
-			return false;
-		}
-
-		//previous level cleanup
-		state.bricks.clear();
-		state.fieldSize = glm::ivec2(0);
-
-		//parse level data
-		std::string::size_type prevPos = 0, pos = 0;
-		while ((pos = levelDesc.find('\n', pos)) != std::string::npos) {
-			std::string_view s = std::string_view(levelDesc.c_str() + prevPos, pos - prevPos);
-			//printf("|-%s-|\n", levelDesc.substr(prevPos, pos - prevPos).c_str());
-			prevPos = ++pos;
-
-			//playing field size update
-			int rowLen = s.size() / 2;
-			if (state.fieldSize.x < rowLen)
-				state.fieldSize.x = rowLen;
-			if (s.size() > 1)
-				state.fieldSize.y++;
-			else
-				continue;
-
-			//parse bricks in this row
-			for (int i = 0; i < s.size() / 2; i++) {
-				char color = s[i * 2];
-				char type = s[i * 2 + 1];
-
-				int c = 1;
-				int t = BrickType::Brick;
-
-				//empty space
-				if (type == ' ' || type == '0')
-					continue;
-
-				//read block color (or keep default if invalid)
-				if (color >= '1' && color <= '9') {
-					c = int(color - '0');
-				}
-
-				//block type resolution
-				const char* code = strchr(BrickType::BrickCodes(), type);
-				if (code != nullptr) {
-					t = int(code - BrickType::BrickCodes());
-					state.bricks.push_back(Brick(i, state.fieldSize.y - 1, t, c));
-				}
-				else {
-					LOG(LOG_WARN, "Invalid brick type ('%c')\n", s[i]);
-				}
-			}
-		}
-		//printf("|-%s-|\n", levelDesc.substr(prevPos, pos - prevPos).c_str());
-		//printf("%d %d\n", state.fieldSize.x, state.fieldSize.y);
-
-		//update brick sizes & positions
-		state.brickSize = glm::vec2(
-			1.f / state.fieldSize.x,
-			(1.f - state.fieldOffsetY) / state.fieldSize.y
-		);
-		for (Brick& b : state.bricks) {
-			b.pos = glm::vec2(
-				-1.f + b.coords.x * state.brickSize.x * 2.f + state.brickSize.x,
-				1.f - b.coords.y * state.brickSize.y * 2.f - state.brickSize.y
-			);
-		}
-
-		LOG(LOG_INFO, "Loaded level from '%s'.\n", filepath);
-		return true;
-	}
-
-	namespace BrickType {
-		const char* brickCodes = "BWGSTKUDLRCF";
-
-		const char* BrickCodes() {
-			return brickCodes;
-		}
-
-		glm::ivec2 GetTypeTexCoord(int type, int color) {
-			static glm::ivec2 tc[] = {
-				glm::ivec2(1,0),		//brick - shouldn't ever be picked
-				glm::ivec2(0,2),		//wall
-				glm::ivec2(1,2),		//platform grow
-				glm::ivec2(2,2),		//platform shrink
-				glm::ivec2(3,2),		//platform sticking
-				glm::ivec2(4,2),		//wall breaker
-				glm::ivec2(5,2),		//ball speed up
-				glm::ivec2(6,2),		//ball slow down
-
-				glm::ivec2(0,3),		//blur
-				glm::ivec2(1,3),		//drunk
-				glm::ivec2(2,3),		//chaos
-				glm::ivec2(3,3),		//confuse
-			};
-
-			if (type == BrickType::Brick)
-				return glm::ivec2(color, 0);
-			else
-				return tc[type];
-		}
-	}
-
 	static glm::vec4 color_lerp(const glm::vec4& a, const glm::vec4& b, float t) {
 		return b * t + a * (1.f - t);
 	}
@@ -1180,18 +1364,27 @@ namespace Game {
 
 		//(float(rand()) / RAND_MAX)
 
-		//new particle generation - only when the ball is moving
-		if (!state.b.onPlatform) {
+		//new particle generation - only from moving balls
+		//(with lots of balls, only every n-th one emits in given tick -> particle count stays bounded)
+		int ballCount = int(sim.balls.size());
+		int stride = glm::max((ballCount + EMISSION_MAX_BALLS - 1) / EMISSION_MAX_BALLS, 1);
+		state.emissionOffset = (state.emissionOffset + 1) % stride;
+
+		for (int k = state.emissionOffset; k < ballCount; k += stride) {
+			const Ball& b = sim.balls[k];
+			if (b.onPlatform)
+				continue;
+
 			Particle p;
 
-			float theta_rad = atan2f(-state.b.dir.y, -state.b.dir.x);
-			float _1_ballSpeed = 1.f / state.b.speed;
+			float theta_rad = atan2f(-b.dir.y, -b.dir.x);
+			float _1_ballSpeed = 1.f / b.speed;
 
 			for (int i = 0; i < 5; i++) {
 				p.lifespan = p.startingLife = (float(rand()) / RAND_MAX) * (EMISSION_LIFESPAN_MAX - EMISSION_LIFESPAN_MIN) + EMISSION_LIFESPAN_MIN;
-				p.position = state.b.pos;
-				p.angle_rad = (float(rand()) / RAND_MAX) * float(M_PI) * 2.f;
-				p.scale = (float(rand()) / RAND_MAX) * (EMISSION_SCALE_MAX - EMISSION_SCALE_MIN) + EMISSION_SCALE_MIN;
+				p.position = p.prevPosition = b.pos;
+				p.angle_rad = p.prevAngle_rad = (float(rand()) / RAND_MAX) * float(M_PI) * 2.f;
+				p.scale = p.prevScale = (float(rand()) / RAND_MAX) * (EMISSION_SCALE_MAX - EMISSION_SCALE_MIN) + EMISSION_SCALE_MIN;
 
 				float angle_rad = theta_rad + ((float(rand()) / RAND_MAX) * 2.f * M_PI - M_PI) * EMISSION_MAX_VELOCITY_OFFSET_ANGLE;
 				p.velocity = glm::vec2(cosf(angle_rad), sinf(angle_rad)) * ((EMISSION_SPEED_MAX - EMISSION_SPEED_MIN) * (float(rand()) / RAND_MAX) + EMISSION_SPEED_MIN) * _1_ballSpeed;
@@ -2,8 +2,71 @@
 
 #include "breakout/game.h"
 
+#include <string.h>
+#include <stdlib.h>
+#include <exception>
+
 int main(int argc, char** argv) {
-	Game::Run();
+	//command line options
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--tickrate") == 0 && i + 1 < argc) {
+			Game::SetTickRate(float(atof(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+			Game::SetStressMode(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+			Game::SetLevelsDirectory(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--autoplay") == 0) {
+			Game::SetAutoplay(true);
+		}
+		else if (strcmp(argv[i], "--render-thread") == 0) {
+			Game::SetRenderThread(true);
+		}
+		else if (strcmp(argv[i], "--headless") == 0) {
+			Game::SetHeadless(true);
+		}
+		else if (strcmp(argv[i], "--software") == 0) {
+			Game::SetSoftwareRenderer(true);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			Game::SetFrameLimit(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) {
+			Game::SetScreenshotFile(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			Game::SetTraceFile(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+			Game::SetDynamicResolution(float(atof(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--stats") == 0) {
+			Game::SetStatsOverlay(true);
+		}
+		else if (strcmp(argv[i], "--stats-csv") == 0 && i + 1 < argc) {
+			Game::SetStatsFile(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			Game::SetRecordingFile(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			if (!Game::SetReplayFile(argv[++i]))
+				return 1;
+		}
+		else {
+			LOG(LOG_WARN, "Unknown argument '%s'.\n", argv[i]);
+		}
+	}
+
+	try {
+		Game::Run();
+	}
+	catch (std::exception&) {
+		LOG(LOG_ERROR, "Game terminated due to an error (see above).\n");
+		return 1;
+	}
 
 	Game::Release();
 	LOG(LOG_INFO, "Done.\n");
@@ -1,5 +1,6 @@
 #include "breakout/particles.h"
 #include "breakout/renderer.h"
+#include "breakout/trace.h"
 
 ParticleSystem::ParticleSystem(ParticleUpdateFn ParticleUpdate_, int maxCount) : ParticleUpdate(ParticleUpdate_) {
 	pbuf[0].reserve(maxCount);
@@ -7,16 +8,28 @@ ParticleSystem::ParticleSystem(ParticleUpdateFn ParticleUpdate_, int maxCount) :
 }
 
 void ParticleSystem::Update(float deltaTime) {
+	TRACE_ZONE("ParticleSystem::Update");
+	for (Particle& p : pbuf[currentIdx]) {
+		p.prevPosition = p.position;
+		p.prevAngle_rad = p.angle_rad;
+		p.prevScale = p.scale;
+	}
+
 	ParticleUpdate(pbuf[currentIdx], pbuf[1 - currentIdx], deltaTime);
 	currentIdx = 1 - currentIdx;
 }
 
-void ParticleSystem::Render() {
+void ParticleSystem::Render(float alpha) {
+	TRACE_ZONE("ParticleSystem::Render");
 	for (const Particle& p : pbuf[currentIdx]) {
-		if (fabsf(p.angle_rad) < 1e-3f)
-			Renderer::RenderQuad(glm::vec3(p.position, 0.f), glm::vec2(p.scale * 0.1f), p.color);
+		glm::vec2 position = glm::mix(p.prevPosition, p.position, alpha);
+		float angle_rad = glm::mix(p.prevAngle_rad, p.angle_rad, alpha);
+		float scale = glm::mix(p.prevScale, p.scale, alpha);
+
+		if (fabsf(angle_rad) < 1e-3f)
+			Renderer::RenderQuad(glm::vec3(position, 0.f), glm::vec2(scale * 0.1f), p.color);
 		else
-			Renderer::RenderRotatedQuad(glm::vec3(p.position, 0.f), glm::vec2(p.scale * 0.1f), p.angle_rad, p.color);
+			Renderer::RenderRotatedQuad(glm::vec3(position, 0.f), glm::vec2(scale * 0.1f), angle_rad, p.color);
 		//Renderer::RenderRotatedQuad(glm::vec3(p.position, 0.f), glm::vec2(p.scale * 0.1f), p.angle_rad, p.color);
 	}
 }
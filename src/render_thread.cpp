@@ -0,0 +1,89 @@
+#include "breakout/render_thread.h"
+
+#include "breakout/log.h"
+#include "breakout/window.h"
+#include "breakout/trace.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+RenderThread::RenderThread() {
+	packets[0] = Renderer::CreatePacket();
+	packets[1] = Renderer::CreatePacket();
+
+	//context can only be current on a single thread
+	glfwMakeContextCurrent(nullptr);
+	Renderer::BeginRecording(packets[recordIdx]);
+
+	thread = std::thread(&RenderThread::Loop, this);
+	LOG(LOG_CTOR, "[C] RenderThread\n");
+}
+
+RenderThread::~RenderThread() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	thread.join();
+
+	Renderer::EndRecording();
+	glfwMakeContextCurrent(Window::Get().Handle());
+
+	//calls recorded after the last submitted frame (resizes)
+	Renderer::Replay(packets[recordIdx]);
+	LOG(LOG_DTOR, "[D] RenderThread\n");
+}
+
+void RenderThread::SubmitFrame(double frameStart_) {
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this]() { return !pending; });
+
+	Renderer::EndRecording();
+	frameStart = frameStart_;
+	pending = true;
+
+	//previous frame is already presented -> its packet can be reused
+	recordIdx = 1 - recordIdx;
+	Renderer::BeginRecording(packets[recordIdx]);
+
+	lock.unlock();
+	cv.notify_all();
+}
+
+FrameTimings RenderThread::Timings() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return timings;
+}
+
+void RenderThread::Loop() {
+	TRACE_THREAD("Render");
+	glfwMakeContextCurrent(Window::Get().Handle());
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		cv.wait(lock, [this]() { return pending || quit; });
+		if (!pending)
+			break;
+
+		const Renderer::FramePacketRef& packet = packets[1 - recordIdx];
+		double start = frameStart;
+		lock.unlock();
+
+		{
+			TRACE_ZONE("RenderThread::Replay");
+			Renderer::Replay(packet);
+		}
+		Window::Get().Present();
+		double latency = glfwGetTime() - start;
+
+		lock.lock();
+		timings.frames++;
+		timings.latency_s += latency;
+		pending = false;
+		cv.notify_all();
+	}
+	lock.unlock();
+
+	glfwMakeContextCurrent(nullptr);
+}
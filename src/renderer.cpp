@@ -1,52 +1,36 @@
 #include "breakout/renderer.h"
 #include "breakout/window.h"
+#include "breakout/trace.h"
+
+#include <stdio.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+
+static uint32_t PackColor(const glm::vec4& color) {
+	glm::uvec4 c = glm::uvec4(glm::clamp(color, 0.f, 1.f) * 255.f + 0.5f);
+	return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+}
 
-Vertex::Vertex(const glm::vec3& position_, const glm::vec4& color_, const glm::vec2& texCoords_, float textureID_) : position(position_), color(color_), texCoords(texCoords_), textureID(textureID_), texTiling(glm::vec2(1.f)), alphaTexture(0.f) {}
-
-Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color) : Quad(center, halfSize, color, 0.f, nullptr) {}
-Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color, float angle_rad) : Quad(center, halfSize, color, 0.f, nullptr, angle_rad) {}
-
-Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, float textureID, const ITextureRef& texture) : Quad(center, halfSize, glm::vec4(1.f), textureID, texture) {}
-Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, float textureID, const ITextureRef& texture, float angle_rad) : Quad(center, halfSize, glm::vec4(1.f), textureID, texture, angle_rad) {}
+Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color, float angle_rad) : Quad(center, halfSize, color, nullptr, angle_rad) {}
 
-Quad::Quad(const glm::vec3& center, const glm::vec2& hs, const glm::vec4& colorTint, float textureID, const ITextureRef& texture) {
-	vertices[0] = Vertex(center + glm::vec3(-hs.x, -hs.y, 0.f), colorTint, glm::vec2(0.f, 1.f), textureID);
-	vertices[1] = Vertex(center + glm::vec3(-hs.x, hs.y, 0.f), colorTint, glm::vec2(0.f, 0.f), textureID);
-	vertices[2] = Vertex(center + glm::vec3(hs.x, -hs.y, 0.f), colorTint, glm::vec2(1.f, 1.f), textureID);
-	vertices[3] = Vertex(center + glm::vec3(hs.x, hs.y, 0.f), colorTint, glm::vec2(1.f, 0.f), textureID);
+Quad::Quad(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture, float angle_rad) : Quad(center, halfSize, glm::vec4(1.f), texture, angle_rad) {}
 
+Quad::Quad(const glm::vec3& center_, const glm::vec2& halfSize_, const glm::vec4& colorTint, const ITextureRef& texture, float angle_rad_) 
+	: center(center_), halfSize(halfSize_), angle_rad(angle_rad_), textureHandle(0), color(PackColor(colorTint)) {
 	if (texture != nullptr) {
-		vertices[0].texCoords = texture->TexCoords(0);
-		vertices[1].texCoords = texture->TexCoords(1);
-		vertices[2].texCoords = texture->TexCoords(2);
-		vertices[3].texCoords = texture->TexCoords(3);
+		texRect = glm::vec4(texture->TexCoords(0), texture->TexCoords(3));
 	}
-}
-
-Quad::Quad(const glm::vec3& center, const glm::vec2& hs, const glm::vec4& colorTint, float textureID, const ITextureRef& texture, float angle_rad) {
-	float c = cosf(angle_rad);
-	float s = sinf(angle_rad);
-	glm::mat2 R = glm::mat2(
-		glm::vec2(c, s),
-		glm::vec2(-s, c)
-	);
-	glm::vec2 x = R * glm::vec2(hs.x, 0.f);
-	glm::vec2 y = R * glm::vec2(0.f, hs.y);
-
-	vertices[0] = Vertex(center + glm::vec3(-x - y, 0.f), colorTint, glm::vec2(0.f, 1.f), textureID);
-	vertices[1] = Vertex(center + glm::vec3(-x + y, 0.f), colorTint, glm::vec2(0.f, 0.f), textureID);
-	vertices[2] = Vertex(center + glm::vec3(x - y, 0.f), colorTint, glm::vec2(1.f, 1.f), textureID);
-	vertices[3] = Vertex(center + glm::vec3(x + y, 0.f), colorTint, glm::vec2(1.f, 0.f), textureID);
-
-	if (texture != nullptr) {
-		vertices[0].texCoords = texture->TexCoords(0);
-		vertices[1].texCoords = texture->TexCoords(1);
-		vertices[2].texCoords = texture->TexCoords(2);
-		vertices[3].texCoords = texture->TexCoords(3);
+	else {
+		texRect = glm::vec4(0.f, 1.f, 1.f, 0.f);
 	}
 }
 
-Quad::Quad(const CharInfo& ch, const glm::vec2& pos, float scale, const glm::vec4& color, float textureID, const glm::vec2& _1_atlSize, const glm::vec2& _1_winSize) {
+Quad::Quad(const CharInfo& ch, const glm::vec2& pos, float scale, const glm::vec4& color_, const glm::vec2& _1_atlSize, const glm::vec2& _1_winSize) : textureHandle(0), color(PackColor(color_)), alphaTexture(1.f) {
 	float x = pos.x + (ch.bearing.x * scale) * _1_winSize.x;
 	float y = pos.y - ((ch.size.y - ch.bearing.y) * scale) * _1_winSize.y;
 
@@ -57,149 +41,408 @@ Quad::Quad(const CharInfo& ch, const glm::vec2& pos, float scale, const glm::vec
 	float ow = ch.size.x;
 	float oh = ch.size.y;
 
-	vertices[0] = Vertex(glm::vec3(x  , y  , 0.f), color, glm::vec2(tx   , oh ) * _1_atlSize, textureID);
-	vertices[1] = Vertex(glm::vec3(x  , y+h, 0.f), color, glm::vec2(tx   , 0.f) * _1_atlSize, textureID);
-	vertices[2] = Vertex(glm::vec3(x+w, y  , 0.f), color, glm::vec2(tx+ow, oh ) * _1_atlSize, textureID);
-	vertices[3] = Vertex(glm::vec3(x+w, y+h, 0.f), color, glm::vec2(tx+ow, 0.f) * _1_atlSize, textureID);
-
-	vertices[0].alphaTexture = vertices[1].alphaTexture = 1.f;
-	vertices[2].alphaTexture = vertices[3].alphaTexture = 1.f;
-}
-
-QuadIndices::QuadIndices(int idx) {
-	for(int i = 0; i < 4; i++)
-		indices[i] = (idx * 4) + i;
-	indices[4] = (uint32_t)-1;
+	halfSize = glm::vec2(w, h) * 0.5f;
+	center = glm::vec3(x + halfSize.x, y + halfSize.y, 0.f);
+	texRect = glm::vec4(glm::vec2(tx, oh) * _1_atlSize, glm::vec2(tx + ow, 0.f) * _1_atlSize);
 }
 
 namespace Renderer {
 
-	constexpr int maxTextures = 8;
+	constexpr int ringBatches = 16;		//instance ring capacity (in full batches) - several frames worth of flushes in flight
+	constexpr int profiledFrames = 4;	//timer query sets in flight (results are read, once the GPU is done with the frame)
+	constexpr int textureSlots = 8;		//textures per draw call without bindless textures (MAX_TEXTURE_SLOTS in the shaders)
+
+	void AcquireBatch();
+	void SetupInstanceAttributes();
+
+	//Snapshot of the layer's modified quads (taken by the recording thread, uploaded by the GL thread).
+	struct LayerUpdate {
+		int size = 0;								//layer size at the time of the draw
+		int begin = 0;								//index of the first modified quad
+		std::vector<Quad> quads;					//modified range (whole layer, if it outgrew its GPU buffer)
+		std::vector<const ITexture*> textures;
+	};
+
+	struct LayerDraw {
+		QuadLayer* layer;
+		LayerUpdate update;
+	};
+
+	//GL side of the public calls (executed right away, or when the frame packet is replayed)
+	void ExecBegin(bool deferred, const char* pass);
+	void ExecEnd();
+	void ExecFlush(FlushCause cause);
+	void ExecEndFrame();
+	void ExecSetShader(const ShaderRef& shader);
+	void ExecSubmit(Quad quad, const ITexture* texture);
+	void ExecRenderLayer(LayerDraw&& draw);
+	void QueueQuad(const Quad& quad);
+	int TextureSlot(GLuint texture);
+	void DrawLayer(LayerDraw& draw);
+	void Submit(const Quad& quad, const ITexture* texture);
+
+	//===== deferred mode =====
+
+	enum CommandType : uint8_t { Cmd_Quad, Cmd_Layer };
+
+	//Recorded submission.
+	struct Command {
+		uint8_t type;
+		uint8_t shader;					//index into the session's shader list
+		int payload;					//index of the quad/layer
+	};
+
+	//sort key: | layer (8b) | shader (8b) | texture (24b) | depth (24b) |
+	struct SortItem {
+		uint64_t key;
+		int command;
+	};
+
+	void Record(uint8_t type, uint64_t textureHandle, float depth, int payload);
+	void SortCommands();
+	int CountDrawCalls(const std::vector<SortItem>& order);
+	void EmitCommands();
 
-	float ResolveTextureIdx(const ITextureRef& texture);
+	//===== profiling =====
 
-	struct RendererStats {
-		int drawCalls = 0;
+	//Frame's pass statistics, waiting for the timer query results.
+	struct ProfiledFrame {
+		FrameStats stats;
+		std::vector<GLuint> queries;	//GL_TIME_ELAPSED per pass (reused by the following frames)
+		bool pending = false;
+	};
+
+	bool ResolveFrame(ProfiledFrame& frame, bool force);
+	void PublishFrame(const FrameStats& stats);
+
+	//===== software backend =====
+
+	SoftRaster::Image& SoftScreen();
+	SoftRaster::Image& SoftFramebuffer(const Framebuffer* fbo);
+	uint64_t SoftRegisterTexture(const ITexture* texture);
+	void SoftDraw(const Quad* quads, int count);
+	void SoftPresent();
+	void ExecClear(const FramebufferRef& fbo, const glm::vec4& color);
+
+	//Part of the vertex ring that's used by an already submitted draw call.
+	struct RingRange {
+		GLsync fence;
+		int begin;
+		int end;
 	};
 
 	struct RendererData {
 		GLuint vao = 0;
 		GLuint vbo = 0;
-		GLuint ebo = 0;
 
-		Quad* quadsBuffer = nullptr;
-		QuadIndices* indicesBuffer = nullptr;
+		//instance ring - persistently mapped vbo, batches are written straight into it, one after another (wrapping around)
+		Quad* ring = nullptr;
+		int ringCapacity = 0;			//in quads
+		int ringHead = 0;				//start of the batch that's being filled
+		std::deque<RingRange> inFlight;
+
+		Quad* quadsBuffer = nullptr;	//current batch (points into the ring)
 
 		int batchSize = 1000;
 		int idx = 0;
 
+		//texture slots (no ARB_bindless_texture) - quads carry the slot index + 1, textures are bound to units 0..n-1 at the flush
+		bool useSlots = false;
+		GLuint slotTextures[textureSlots];
+		int slotCount = 0;
+
 		ShaderRef shader = nullptr;
 		bool inProgress = false;
 
-		TextureRef blankTexture = nullptr;
-		ITexture* textures[maxTextures];
-		int texIdx = 1;
-
 		RendererStats stats;
 
 		FramebufferRef fbo = nullptr;
+
+		//deferred session
+		bool deferred = false;
+		uint8_t layer = 0;
+		int shaderID = 0;
+		std::vector<ShaderRef> shaders;						//shaders used during the session (key's shader field)
+		std::unordered_map<uint64_t, uint32_t> textureIDs;	//quad texture handle -> key's texture field (0 = retained layers)
+		std::vector<Command> commands;
+		std::vector<SortItem> sortItems;
+		std::vector<SortItem> sortTmp;
+		std::vector<Quad> quads;
+		std::vector<LayerDraw> layers;
+
+		//profiling (GL thread)
+		bool profiling = false;
+		ProfiledFrame frames[profiledFrames];
+		int frameSlot = 0;
+		int frameCount = 0;
+		bool queryActive = false;		//session's timer query is running
+		std::chrono::steady_clock::time_point passStart;
+		FILE* csv = nullptr;
+
+		//last resolved frame (read by the game thread)
+		std::mutex publishMutex;
+		FrameStats published;
+
+		//software backend (batches live in softBatch instead of the ring)
+		//quads carry GL texture names in place of the bindless handles (ARB_bindless_texture isn't required)
+		Backend backend = Backend::OpenGL;
+		std::unique_ptr<SoftRaster::Rasterizer> raster;
+		std::vector<Quad> softBatch;
+		SoftRaster::Image screen;											//default render target
+		std::unordered_map<const Framebuffer*, SoftRaster::Image> softTargets;
+		std::unordered_map<uint64_t, SoftRaster::Image> softTextures;		//CPU copies of the sampled textures
+		std::unordered_map<uint64_t, const SoftRaster::Image*> softImages;	//GL texture name -> image, that's sampled in its place
+		std::vector<const SoftRaster::Image*> softBatchImages;
+		const ITexture* softLastTexture = nullptr;							//last submitted texture & its name (per session)
+		uint64_t softLastName = 0;
+		GLuint screenTexture = 0;			//screen upload, blitted into the default framebuffer
+		GLuint screenFbo = 0;
 	};
 
 	static RendererData data;
 
+	//===== frame packets =====
+
+	enum PacketOpType : uint8_t { Op_Begin, Op_End, Op_Flush, Op_SetShader, Op_SetLayer, Op_UseFBO, Op_Quads, Op_Layer, Op_Call, Op_EndFrame };
+
+	struct PacketOp {
+		uint8_t type;
+		uint8_t arg;					//deferred flag / sort layer
+		int payload;					//index into the packet's array of the matching type
+		int count;						//number of consecutive quads (Op_Quads)
+	};
+
+	//Renderer calls of one frame, in the submission order.
+	struct FramePacket {
+		std::vector<PacketOp> ops;
+		std::vector<Quad> quads;
+		std::vector<const ITexture*> textures;			//per quad (bindless handles are resolved on the GL thread)
+		std::vector<ShaderRef> shaders;
+		std::vector<FramebufferRef> fbos;
+		std::vector<LayerDraw> layers;
+		std::vector<std::function<void()>> calls;
+		std::vector<const char*> passes;				//session names (Op_Begin)
+	};
+
+	static FramePacket* recording = nullptr;			//packet, that the calls are redirected into (touched by the recording thread only)
+
+	//copy of the last submitted quad (the ring is write-only & the batch can get flushed right after the submit)
+	static Quad lastQuad;
+	static bool hasLastQuad = false;
+
+	void PushOp(uint8_t type, uint8_t arg = 0, int payload = 0) {
+		recording->ops.push_back({ type, arg, payload, 0 });
+	}
+
 	void Release() {
-		delete[] data.quadsBuffer;
-		delete[] data.indicesBuffer;
+		for (RingRange& r : data.inFlight) {
+			glDeleteSync(r.fence);
+		}
+		data.inFlight.clear();
+
+		if (data.ring != nullptr) {
+			glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glDeleteBuffers(1, &data.vbo);
+			glDeleteVertexArrays(1, &data.vao);
+			data.ring = nullptr;
+			data.quadsBuffer = nullptr;
+		}
+
+		if (data.screenFbo != 0) {
+			glDeleteFramebuffers(1, &data.screenFbo);
+			glDeleteTextures(1, &data.screenTexture);
+			data.screenFbo = data.screenTexture = 0;
+		}
+		data.raster = nullptr;
+		data.softTargets.clear();
+		data.softTextures.clear();
+		data.softImages.clear();
+		data.softLastTexture = nullptr;
+
+		for (ProfiledFrame& frame : data.frames) {
+			if (!frame.queries.empty()) {
+				glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+				frame.queries.clear();
+			}
+		}
+		if (data.csv != nullptr) {
+			fclose(data.csv);
+			data.csv = nullptr;
+		}
 
 		data.shader = nullptr;
-		data.blankTexture = nullptr;
-		for (int i = 0; i < maxTextures; i++)
-			data.textures[i] = nullptr;
+		data.shaders.clear();
 		data.fbo = nullptr;
 		LOG(LOG_DTOR, "[D] Renderer\n");
 	}
 
 	void SetShader(ShaderRef& shader) {
+		if (recording != nullptr) {
+			PushOp(Op_SetShader, 0, int(recording->shaders.size()));
+			recording->shaders.push_back(shader);
+			return;
+		}
+		ExecSetShader(shader);
+	}
+
+	void ExecSetShader(const ShaderRef& shader) {
+		if (data.inProgress) {
+			if (data.deferred) {
+				//shader is only selected per command, when the session's emitted
+				auto it = std::find(data.shaders.begin(), data.shaders.end(), shader);
+				if (it == data.shaders.end()) {
+					ASSERT_MSG(data.shaders.size() < 256, "\tRenderer - too many shaders in a single deferred session.\n");
+					it = data.shaders.insert(data.shaders.end(), shader);
+				}
+				data.shaderID = int(it - data.shaders.begin());
+				return;
+			}
+
+			//quads queued so far use the previous shader
+			ExecFlush(Flush_Shader);
+		}
 		data.shader = shader;
 	}
 
-	void Begin() {
-		ASSERT_MSG(data.shader != nullptr, "\tRenderer - calling Begin() without a proper shader - set shader via SetShader() function.\n");
+	void SetLayer(uint8_t layer) {
+		if (recording != nullptr) {
+			PushOp(Op_SetLayer, layer);
+			return;
+		}
+		data.layer = layer;
+	}
+
+	void Begin(bool deferred, const char* pass) {
+		if (recording != nullptr) {
+			PushOp(Op_Begin, deferred, int(recording->passes.size()));
+			recording->passes.push_back(pass);
+			return;
+		}
+		ExecBegin(deferred, pass);
+	}
+
+	void ExecBegin(bool deferred, const char* pass) {
+		ASSERT_MSG(data.shader != nullptr || data.backend == Backend::Software, "\tRenderer - calling Begin() without a proper shader - set shader via SetShader() function.\n");
 
 		if (data.inProgress) {
 			LOG(LOG_WARN, "Renderer - Multiple Begin() calls without calling End().\n");
 		}
 		data.inProgress = true;
-		data.stats.drawCalls = 0;
+		data.stats = RendererStats();
+
+		data.deferred = deferred;
+		data.layer = 0;
+		data.shaderID = 0;
+		data.shaders.assign(1, data.shader);
+		data.textureIDs.clear();
+		data.commands.clear();
+		data.sortItems.clear();
+		data.quads.clear();
+		data.layers.clear();
 
 		//first call -> allocate resources
-		if (data.quadsBuffer == nullptr) {
-			//=== quad vertices & indices buffers ===
-			data.quadsBuffer = new Quad[data.batchSize];
-			data.indicesBuffer = new QuadIndices[data.batchSize];
+		if (data.backend == Backend::Software) {
+			data.softLastTexture = nullptr;
+			if (data.raster == nullptr) {
+				data.raster = std::make_unique<SoftRaster::Rasterizer>();
+				data.softBatch.resize(data.batchSize);
+				data.quadsBuffer = data.softBatch.data();
+			}
+		}
+		else if (data.ring == nullptr) {
+			//quads reference their textures directly, if possible (no texture slots -> no batch breaks on texture changes)
+			data.useSlots = !BindlessTextures();
+			data.slotCount = 0;
 
-			//=== their GPU counterparts ===
+			//=== GPU buffers ===
 			glGenVertexArrays(1, &data.vao);
 			glGenBuffers(1, &data.vbo);
-			glGenBuffers(1, &data.ebo);
 
 			glBindVertexArray(data.vao);
-
-			glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
-
-			//proper attributes setup
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texTiling));
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureID));
-			glEnableVertexAttribArray(4);
-			glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, alphaTexture));
-			glEnableVertexAttribArray(5);
-
 			glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Quad) * data.batchSize, nullptr, GL_DYNAMIC_DRAW);
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ebo);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(QuadIndices) * data.batchSize, nullptr, GL_DYNAMIC_DRAW);
+			SetupInstanceAttributes();
 
-			//=== empty texture ===
-			uint8_t tmp[] = { 255,255,255,255 };
-			data.blankTexture = std::make_shared<Texture>(1, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, &tmp, "blankTexture");
+			//instance ring - immutable storage, mapped for the whole lifetime (coherent -> no explicit flushes needed)
+			GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			data.ringCapacity = data.batchSize * ringBatches;
+			glBufferStorage(GL_ARRAY_BUFFER, sizeof(Quad) * data.ringCapacity, nullptr, mapFlags);
+			data.ring = (Quad*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(Quad) * data.ringCapacity, mapFlags);
+			ASSERT_MSG(data.ring != nullptr, "Renderer - Failed to map the instance ring buffer.\n");
+			data.ringHead = 0;
+			AcquireBatch();
 		}
 
-		for (int i = 0; i < maxTextures; i++) {
-			data.textures[i] = data.blankTexture.get();
-		}
+		data.idx = 0;
 
-		//=== setup texture slots in shader ===
-		data.shader->Bind();
-		char buf[256];
-		for (int i = 0; i < maxTextures; i++) {
-			snprintf(buf, sizeof(buf), "textures[%d]", i);
-			data.shader->SetInt(buf, i);
+		if (data.profiling && !data.queryActive) {
+			ProfiledFrame& frame = data.frames[data.frameSlot];
+			int passIdx = int(frame.stats.passes.size());
+			if (passIdx == int(frame.queries.size())) {
+				GLuint query;
+				glGenQueries(1, &query);
+				frame.queries.push_back(query);
+			}
+			frame.stats.passes.push_back({ pass });
+			glBeginQuery(GL_TIME_ELAPSED, frame.queries[passIdx]);
+			data.queryActive = true;
+			data.passStart = std::chrono::steady_clock::now();
 		}
-
-		data.idx = 0;
-		data.texIdx = 1;
 	}
 
 	void End() {
+		if (recording != nullptr) {
+			PushOp(Op_End);
+			return;
+		}
+		ExecEnd();
+	}
+
+	void ExecEnd() {
 		if (!data.inProgress) {
 			LOG(LOG_WARN, "Renderer - Multiple End() calls without calling Begin().\n");
 		}
 		data.inProgress = false;
 
-		Flush();
+		if (data.deferred) {
+			EmitCommands();
+			data.deferred = false;
+		}
+
+		ExecFlush(Flush_Explicit);
 		//LOG(LOG_INFO, "Draw calls: %d\n", data.stats.drawCalls);
+
+		if (data.queryActive) {
+			glEndQuery(GL_TIME_ELAPSED);
+			data.queryActive = false;
+			PassStats& pass = data.frames[data.frameSlot].stats.passes.back();
+			pass.stats = data.stats;
+			pass.cpuTime_ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - data.passStart).count();
+		}
 	}
 
 	void Flush() {
+		if (recording != nullptr) {
+			PushOp(Op_Flush);
+			return;
+		}
+		ExecFlush(Flush_Explicit);
+	}
+
+	void ExecFlush(FlushCause cause) {
 		if (data.idx > 0) {
+			TRACE_ZONE("Renderer::Flush");
+			data.stats.flushes[cause]++;
+			data.stats.quads += data.idx;
+
+			if (data.backend == Backend::Software) {
+				SoftDraw(data.quadsBuffer, data.idx);
+				data.stats.drawCalls++;
+				data.idx = 0;
+				return;
+			}
+			data.stats.bytesUploaded += int64_t(sizeof(Quad)) * data.idx;
 
 			if (data.fbo != nullptr) {
 				data.fbo->Bind();
@@ -208,78 +451,157 @@ namespace Renderer {
 				Framebuffer::Unbind();
 			}
 
-			glEnable(GL_PRIMITIVE_RESTART);
-			glPrimitiveRestartIndex((unsigned int)-1);
-
 			data.shader->Bind();
 			glBindVertexArray(data.vao);
-
-			glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Quad) * data.idx, data.quadsBuffer);
-
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ebo);
-			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(QuadIndices) * data.idx, data.indicesBuffer);
-
-			for (int i = 0; i < maxTextures; i++) {
-				data.textures[i]->Bind(i);
+			if (data.slotCount > 0) {
+				glBindTextures(0, data.slotCount, data.slotTextures);
 			}
 
-			glDrawElements(GL_TRIANGLE_STRIP, data.idx * 5, GL_UNSIGNED_INT, nullptr);
+			//instances are already in the ring (written directly by Render* calls)
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, data.idx, data.ringHead);
 			data.stats.drawCalls++;
+
+			//batch's ring range stays reserved until the draw call is done
+			GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			data.inFlight.push_back({ fence, data.ringHead, data.ringHead + data.idx });
+			data.ringHead += data.idx;
+			AcquireBatch();
 		}
 
 		data.idx = 0;
-		data.texIdx = 1;
+		data.slotCount = 0;
 	}
 
-	void RenderQuad(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture) {
-		float textureIdx = ResolveTextureIdx(texture);
+	//Instance attributes layout (of the currently bound VAO & array buffer).
+	void SetupInstanceAttributes() {
+		//per-instance attributes (quad corners are derived from gl_VertexID)
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Quad), (void*)offsetof(Quad, center));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Quad), (void*)offsetof(Quad, halfSize));
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Quad), (void*)offsetof(Quad, angle_rad));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Quad), (void*)offsetof(Quad, texRect));
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Quad), (void*)offsetof(Quad, color));
+		glVertexAttribIPointer(5, 2, GL_UNSIGNED_INT, sizeof(Quad), (void*)offsetof(Quad, textureHandle));
+		glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(Quad), (void*)offsetof(Quad, alphaTexture));
+		for (int i = 0; i <= 6; i++) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribDivisor(i, 1);
+		}
+	}
 
-		data.quadsBuffer[data.idx] = Quad(center, halfSize, textureIdx, texture);
-		data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-		data.idx++;
+	//Moves the batch pointer to the free part of the ring (room for a full batch).
+	//Waits for the GPU, if the space is still used by submitted draw calls.
+	void AcquireBatch() {
+		if (data.ringHead + data.batchSize > data.ringCapacity) {
+			data.ringHead = 0;
+		}
+		int begin = data.ringHead;
+		int end = begin + data.batchSize;
 
-		if (data.idx >= data.batchSize) {
-			Flush();
+		//release the ranges, that the GPU is already done with
+		while (!data.inFlight.empty() && glClientWaitSync(data.inFlight.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			glDeleteSync(data.inFlight.front().fence);
+			data.inFlight.pop_front();
 		}
-	}
 
-	void RenderQuad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color) {
-		data.quadsBuffer[data.idx] = Quad(center, halfSize, color);
-		data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-		data.idx++;
+		//find the most recent range overlapping the new batch (fences signal in order -> waiting for that one covers all the older ones)
+		int last = -1;
+		for (int i = 0; i < int(data.inFlight.size()); i++) {
+			if (data.inFlight[i].begin < end && data.inFlight[i].end > begin) {
+				last = i;
+			}
+		}
 
-		if (data.idx >= data.batchSize) {
-			Flush();
+		if (last >= 0) {
+			GLsync fence = data.inFlight[last].fence;
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+			data.stats.ringWaits++;
+
+			for (int i = 0; i <= last; i++) {
+				glDeleteSync(data.inFlight.front().fence);
+				data.inFlight.pop_front();
+			}
 		}
+
+		data.quadsBuffer = data.ring + data.ringHead;
+	}
+
+	void RenderQuad(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture) {
+		Submit(Quad(center, halfSize, texture), texture.get());
+	}
+
+	void RenderQuad(const glm::vec3& center, const glm::vec2& halfSize, const glm::vec4& color) {
+		Submit(Quad(center, halfSize, color), nullptr);
 	}
 
 	void RenderRotatedQuad(const glm::vec3& center, const glm::vec2& halfSize, float angle_rad, const ITextureRef& texture) {
-		float textureIdx = ResolveTextureIdx(texture);
+		Submit(Quad(center, halfSize, texture, angle_rad), texture.get());
+	}
 
-		data.quadsBuffer[data.idx] = Quad(center, halfSize, textureIdx, texture, angle_rad);
-		data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-		data.idx++;
+	void RenderRotatedQuad(const glm::vec3& center, const glm::vec2& halfSize, float angle_rad, const glm::vec4& color) {
+		Submit(Quad(center, halfSize, color, angle_rad), nullptr);
+	}
 
-		if (data.idx >= data.batchSize) {
-			Flush();
+	void RenderLayer(QuadLayer& layer) {
+		if (layer.Size() == 0)
+			return;
+
+		LayerDraw draw = { &layer };
+		layer.TakeUpdate(draw.update);
+
+		if (recording != nullptr) {
+			PushOp(Op_Layer, 0, int(recording->layers.size()));
+			recording->layers.push_back(std::move(draw));
+			return;
 		}
+		ExecRenderLayer(std::move(draw));
 	}
 
-	void RenderRotatedQuad(const glm::vec3& center, const glm::vec2& halfSize, float angle_rad, const glm::vec4& color) {
-		data.quadsBuffer[data.idx] = Quad(center, halfSize, color, angle_rad);
-		data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-		data.idx++;
+	void ExecRenderLayer(LayerDraw&& draw) {
+		if (data.deferred) {
+			Record(Cmd_Layer, 0, 0.f, int(data.layers.size()));
+			data.layers.push_back(std::move(draw));
+			return;
+		}
+		DrawLayer(draw);
+	}
 
-		if (data.idx >= data.batchSize) {
-			Flush();
+	void DrawLayer(LayerDraw& draw) {
+		QuadLayer& layer = *draw.layer;
+
+		//preserve the submission order
+		ExecFlush(Flush_Order);
+		layer.Apply(draw.update);
+		data.stats.quads += draw.update.size;
+
+		if (data.backend == Backend::Software) {
+			SoftDraw(layer.softQuads.data(), draw.update.size);
+			data.stats.drawCalls++;
+			return;
+		}
+		data.stats.bytesUploaded += int64_t(sizeof(Quad)) * draw.update.quads.size();
+
+		if (data.fbo != nullptr) {
+			data.fbo->Bind();
+		}
+		else {
+			Framebuffer::Unbind();
 		}
+
+		data.shader->Bind();
+		glBindVertexArray(layer.vao);
+		if (!layer.slotTextures.empty()) {
+			glBindTextures(0, GLsizei(layer.slotTextures.size()), layer.slotTextures.data());
+		}
+
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, draw.update.size);
+		data.stats.drawCalls++;
 	}
 
 	void RenderText(const FontRef& font, const char* text, const glm::vec2& topLeft, float scale, const glm::vec4& color) {
+		TRACE_ZONE("Renderer::RenderText");
 
 		glm::vec2 pos = topLeft;
-		float textureID = ResolveTextureIdx(font->GetAtlasTexture());
+		const ITexture* atlas = font->GetAtlasTexture().get();
 
 		glm::vec2 _1_winSize = 1.f / glm::vec2(Window::Get().Width(), Window::Get().Height());
 
@@ -287,23 +609,18 @@ namespace Renderer {
 		std::string::const_iterator c;
 		for (const char* c = text; *c; c++) {
 			const CharInfo& ch = font->GetChar(*c);
-			data.quadsBuffer[data.idx] = Quad(ch, pos, scale, color, textureID, font->AtlasSizeDenom(), _1_winSize);
-			data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-			data.idx++;
+			Submit(Quad(ch, pos, scale, color, font->AtlasSizeDenom(), _1_winSize), atlas);
 
 			pos.x += (ch.advance.x * scale) * _1_winSize.x;
 			pos.y += (ch.advance.y * scale) * _1_winSize.y;
-
-			if (data.idx >= data.batchSize) {
-				Flush();
-			}
 		}
 
 	}
 
 	void RenderText_Centered(const FontRef& font, const char* text, const glm::vec2& center, float scale, const glm::vec4& color) {
+		TRACE_ZONE("Renderer::RenderText");
 		glm::vec2 _1_winSize = 1.f / glm::vec2(Window::Get().Width(), Window::Get().Height());
-		float textureID = ResolveTextureIdx(font->GetAtlasTexture());
+		const ITexture* atlas = font->GetAtlasTexture().get();
 
 		int width = 0;
 		int height = 0;
@@ -321,59 +638,612 @@ namespace Renderer {
 		// iterate through all characters
 		for (const char* c = text; *c; c++) {
 			const CharInfo& ch = font->GetChar(*c);
-			data.quadsBuffer[data.idx] = Quad(ch, pos, scale, color, textureID, font->AtlasSizeDenom(), _1_winSize);
-			data.indicesBuffer[data.idx] = QuadIndices(data.idx);
-			data.idx++;
+			Submit(Quad(ch, pos, scale, color, font->AtlasSizeDenom(), _1_winSize), atlas);
 
 			pos.x += (ch.advance.x * scale) * _1_winSize.x;
 			pos.y += (ch.advance.y * scale) * _1_winSize.y;
-
-			if (data.idx >= data.batchSize) {
-				Flush();
-			}
 		}
 
 	}
 
 	Quad GetLastQuad() {
-		ASSERT_MSG(data.idx != 0, "\tAttempting to retrieve quad, when no quads were rendered yet.\n");
-		return data.quadsBuffer[data.idx-1];
+		ASSERT_MSG(hasLastQuad, "\tAttempting to retrieve quad, when no quads were rendered yet.\n");
+		return lastQuad;
 	}
 
 	void UseFBO(FramebufferRef fbo) {
+		if (recording != nullptr) {
+			PushOp(Op_UseFBO, 0, int(recording->fbos.size()));
+			recording->fbos.push_back(fbo);
+			return;
+		}
 		data.fbo = fbo;
 	}
 
-	float ResolveTextureIdx(const ITextureRef& texture) {
-		float idx = 0.f;
+	void Enqueue(std::function<void()> fn) {
+		if (recording != nullptr) {
+			PushOp(Op_Call, 0, int(recording->calls.size()));
+			recording->calls.push_back(std::move(fn));
+			return;
+		}
+		fn();
+	}
+
+	const RendererStats& Stats() {
+		return data.stats;
+	}
+
+	void SetBackend(Backend backend) {
+		ASSERT_MSG(data.ring == nullptr && data.raster == nullptr, "\tRenderer - backend has to be selected before the first Begin().\n");
+		data.backend = backend;
+	}
 
-		SubTexture* st = dynamic_cast<SubTexture*>(texture.get());
-		ITexture* tex = texture.get();
-		if (st != nullptr) {
-			tex = st->GetAtlas();
+	Backend GetBackend() {
+		return data.backend;
+	}
+
+	bool BindlessTextures() {
+		return GLAD_GL_ARB_bindless_texture != 0;
+	}
+
+	void Clear(const FramebufferRef& fbo, const glm::vec4& color) {
+		Enqueue([fbo, color]() { ExecClear(fbo, color); });
+	}
+
+	void ExecClear(const FramebufferRef& fbo, const glm::vec4& color) {
+		if (data.backend == Backend::Software) {
+			SoftRaster::Image& target = (fbo != nullptr) ? SoftFramebuffer(fbo.get()) : SoftScreen();
+			target.Clear(PackColor(color));
+			return;
+		}
+
+		if (fbo != nullptr) {
+			fbo->Bind();
 		}
+		else {
+			Framebuffer::Unbind();
+		}
+		glClearColor(color.r, color.g, color.b, color.a);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	void SoftwarePostprocess(const FramebufferRef& source, const SoftRaster::PostprocParams& params) {
+		Enqueue([source, params]() {
+			ASSERT_MSG(data.backend == Backend::Software && data.inProgress, "\tRenderer - SoftwarePostprocess() needs the software backend & an active session.\n");
+			ExecFlush(Flush_Order);
+
+			SoftRaster::Image& target = (data.fbo != nullptr) ? SoftFramebuffer(data.fbo.get()) : SoftScreen();
+			data.raster->Postprocess(SoftFramebuffer(source.get()), target, params);
+			data.stats.drawCalls++;
+		});
+	}
 
-		//search for the texture in already queued textures
-		for (int i = 0; i < maxTextures; i++) {
-			if (data.textures[i] == tex) {
-				idx = float(i);
+	//===== profiling =====
+
+	void EnableProfiling(const std::string& csvFilepath) {
+		data.profiling = true;
+		data.frames[data.frameSlot].stats.frame = data.frameCount;
+
+		if (!csvFilepath.empty()) {
+			data.csv = fopen(csvFilepath.c_str(), "w");
+			if (data.csv == nullptr) {
+				LOG(LOG_WARN, "Renderer - failed to open '%s' for writing.\n", csvFilepath.c_str());
+				return;
+			}
+			fprintf(data.csv, "frame,pass,cpu_ms,gpu_ms,draw_calls,quads,flush_batch_full,flush_shader,flush_order,flush_textures,flush_explicit,bytes_uploaded,ring_waits\n");
+			LOG(LOG_INFO, "Renderer stats are written into '%s'\n", csvFilepath.c_str());
+		}
+	}
+
+	void EndFrame() {
+		if (recording != nullptr) {
+			PushOp(Op_EndFrame);
+			return;
+		}
+		ExecEndFrame();
+	}
+
+	void ExecEndFrame() {
+		if (data.backend == Backend::Software) {
+			SoftPresent();
+		}
+
+		if (!data.profiling)
+			return;
+
+		data.frames[data.frameSlot].pending = true;
+
+		//publish the frames, that the GPU is already done with (oldest first)
+		for (int i = 1; i <= profiledFrames; i++) {
+			ProfiledFrame& frame = data.frames[(data.frameSlot + i) % profiledFrames];
+			if (frame.pending && !ResolveFrame(frame, false))
 				break;
+		}
+
+		//GPU is too far behind -> the oldest frame gets published without (some of) its GPU timings, so that the queries can be reused
+		data.frameSlot = (data.frameSlot + 1) % profiledFrames;
+		ProfiledFrame& next = data.frames[data.frameSlot];
+		if (next.pending) {
+			ResolveFrame(next, true);
+		}
+
+		next.stats.frame = ++data.frameCount;
+		next.stats.passes.clear();
+	}
+
+	//Reads frame's timer queries (without waiting for the GPU). Returns false, if the results aren't available yet (unless forced).
+	bool ResolveFrame(ProfiledFrame& frame, bool force) {
+		std::vector<PassStats>& passes = frame.stats.passes;
+		for (int i = 0; i < int(passes.size()); i++) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				if (!force)
+					return false;
+				continue;
+			}
+
+			GLuint64 elapsed_ns = 0;
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed_ns);
+			passes[i].gpuTime_ms = double(elapsed_ns) * 1e-6;
+		}
+
+		PublishFrame(frame.stats);
+		frame.pending = false;
+		return true;
+	}
+
+	void PublishFrame(const FrameStats& stats) {
+		if (data.csv != nullptr) {
+			for (const PassStats& pass : stats.passes) {
+				const RendererStats& s = pass.stats;
+				fprintf(data.csv, "%d,%s,%.4f,%.4f,%d,%d,%d,%d,%d,%d,%d,%lld,%d\n", stats.frame, pass.name, pass.cpuTime_ms, pass.gpuTime_ms, s.drawCalls, s.quads,
+					s.flushes[Flush_BatchFull], s.flushes[Flush_Shader], s.flushes[Flush_Order], s.flushes[Flush_Textures], s.flushes[Flush_Explicit], (long long)s.bytesUploaded, s.ringWaits);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(data.publishMutex);
+		data.published = stats;
+	}
+
+	FrameStats LastFrameStats() {
+		std::lock_guard<std::mutex> lock(data.publishMutex);
+		return data.published;
+	}
+
+	void Submit(const Quad& quad, const ITexture* texture) {
+		lastQuad = quad;
+		hasLastQuad = true;
+
+		if (recording != nullptr) {
+			//consecutive quads share a single op
+			if (recording->ops.empty() || recording->ops.back().type != Op_Quads) {
+				PushOp(Op_Quads, 0, int(recording->quads.size()));
 			}
+			recording->ops.back().count++;
+			recording->quads.push_back(quad);
+			recording->textures.push_back(texture);
+			return;
 		}
+		ExecSubmit(quad, texture);
+	}
 
-		//not found, add texture into it's own slot
-		if (idx == 0.f) {
-			//trigger a draw call, if all the slots are already taken
-			if (data.texIdx >= maxTextures) {
-				Flush();
+	//Queues a quad into the current batch (or records it, in deferred session).
+	void ExecSubmit(Quad quad, const ITexture* texture) {
+		if (texture != nullptr) {
+			if (data.backend == Backend::Software) {
+				if (texture != data.softLastTexture) {
+					data.softLastName = SoftRegisterTexture(texture);
+					data.softLastTexture = texture;
+				}
+				quad.textureHandle = data.softLastName;
+			}
+			else if (data.useSlots) {
+				quad.textureHandle = texture->UnderlyingHandle();		//mapped to a slot, once the quad gets into a batch
 			}
+			else {
+				quad.textureHandle = texture->BindlessHandle();
+			}
+		}
 
-			idx = data.texIdx;
-			data.textures[data.texIdx] = tex;
-			data.texIdx++;
+		if (data.deferred) {
+			Record(Cmd_Quad, quad.textureHandle, quad.center.z, int(data.quads.size()));
+			data.quads.push_back(quad);
+			return;
 		}
+		QueueQuad(quad);
+	}
 
+	void QueueQuad(const Quad& quad) {
+		//(slot lookup can flush the batch -> resolved before the quad is written)
+		uint64_t textureHandle = quad.textureHandle;
+		if (data.useSlots && textureHandle != 0) {
+			textureHandle = uint64_t(TextureSlot(GLuint(textureHandle))) + 1;
+		}
+
+		data.quadsBuffer[data.idx] = quad;
+		data.quadsBuffer[data.idx].textureHandle = textureHandle;
+		data.idx++;
+
+		if (data.idx >= data.batchSize) {
+			ExecFlush(Flush_BatchFull);
+		}
+	}
+
+	//Slot of the texture within the current batch (batch gets flushed, if the slots are all taken).
+	int TextureSlot(GLuint texture) {
+		for (int i = 0; i < data.slotCount; i++) {
+			if (data.slotTextures[i] == texture)
+				return i;
+		}
+
+		if (data.slotCount == textureSlots) {
+			ExecFlush(Flush_Textures);
+		}
+		data.slotTextures[data.slotCount] = texture;
+		return data.slotCount++;
+	}
+
+	//===== deferred mode =====
+
+	void Record(uint8_t type, uint64_t textureHandle, float depth, int payload) {
+		//textures are numbered in the order of their first use (0 is reserved for retained layers -> drawn first within their layer)
+		uint32_t textureID = 0;
+		if (type == Cmd_Quad) {
+			auto it = data.textureIDs.find(textureHandle);
+			if (it == data.textureIDs.end()) {
+				it = data.textureIDs.emplace(textureHandle, uint32_t(data.textureIDs.size() + 1)).first;
+			}
+			textureID = std::min(it->second, 0xFFFFFFu);
+		}
+
+		//back to front (z = 1 is the furthest)
+		uint32_t depthBits = uint32_t((1.f - glm::clamp(depth, -1.f, 1.f)) * 0.5f * float(0xFFFFFF));
+
+		uint64_t key = (uint64_t(data.layer) << 56) | (uint64_t(data.shaderID) << 48) | (uint64_t(textureID) << 24) | uint64_t(depthBits);
+		data.sortItems.push_back({ key, int(data.commands.size()) });
+		data.commands.push_back({ type, uint8_t(data.shaderID), payload });
+	}
+
+	//LSD radix sort, byte per pass. Stable -> commands with equal keys keep the submission order.
+	void SortCommands() {
+		std::vector<SortItem>& items = data.sortItems;
+		std::vector<SortItem>& tmp = data.sortTmp;
+		int n = int(items.size());
+		tmp.resize(n);
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			int count[256] = {};
+			for (const SortItem& item : items) {
+				count[(item.key >> shift) & 0xFF]++;
+			}
+
+			//all the keys share this byte -> nothing to reorder
+			if (count[(items[0].key >> shift) & 0xFF] == n)
+				continue;
+
+			int offset = 0;
+			for (int b = 0; b < 256; b++) {
+				int c = count[b];
+				count[b] = offset;
+				offset += c;
+			}
+
+			for (const SortItem& item : items) {
+				tmp[count[(item.key >> shift) & 0xFF]++] = item;
+			}
+			items.swap(tmp);
+		}
+	}
+
+	//Number of draw calls, that emitting the commands in given order takes.
+	int CountDrawCalls(const std::vector<SortItem>& order) {
+		int calls = 0;
+		int batch = 0;
+		int shader = -1;
+		for (const SortItem& item : order) {
+			const Command& cmd = data.commands[item.command];
+			if (cmd.type == Cmd_Layer || cmd.shader != shader) {
+				calls += (batch > 0);
+				batch = 0;
+				shader = cmd.shader;
+			}
+
+			if (cmd.type == Cmd_Layer) {
+				calls++;
+			}
+			else if (++batch >= data.batchSize) {
+				calls++;
+				batch = 0;
+			}
+		}
+		return calls + (batch > 0);
+	}
+
+	void EmitCommands() {
+		if (data.commands.empty())
+			return;
+
+		data.stats.commands = int(data.commands.size());
+		data.stats.unsortedDrawCalls = CountDrawCalls(data.sortItems);
+		SortCommands();
+		data.stats.sortedDrawCalls = CountDrawCalls(data.sortItems);
+
+		data.deferred = false;
+		int shader = -1;
+		for (const SortItem& item : data.sortItems) {
+			const Command& cmd = data.commands[item.command];
+			if (cmd.shader != shader) {
+				ExecFlush(Flush_Shader);
+				data.shader = data.shaders[cmd.shader];
+				shader = cmd.shader;
+			}
+
+			if (cmd.type == Cmd_Layer) {
+				DrawLayer(data.layers[cmd.payload]);
+			}
+			else {
+				QueueQuad(data.quads[cmd.payload]);
+			}
+		}
+
+		data.shader = data.shaders[data.shaderID];
+		data.sortItems.clear();
+	}
+
+	//===== QuadLayer =====
+
+	QuadLayer::~QuadLayer() {
+		if (vbo != 0) {
+			glDeleteBuffers(1, &vbo);
+			glDeleteVertexArrays(1, &vao);
+		}
+	}
+
+	void QuadLayer::Clear() {
+		quads.clear();
+		textures.clear();
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	int QuadLayer::Add(const glm::vec3& center, const glm::vec2& halfSize, const ITextureRef& texture, const glm::vec4& colorTint) {
+		int idx = int(quads.size());
+		quads.push_back(Quad(center, halfSize, colorTint, texture));
+		textures.push_back(texture.get());
+		MarkDirty(idx);
 		return idx;
 	}
 
+	void QuadLayer::Remove(int idx) {
+		ASSERT(idx >= 0 && idx < int(quads.size()));
+
+		//degenerate & transparent -> no fragments
+		quads[idx].halfSize = glm::vec2(0.f);
+		quads[idx].color = 0;
+		MarkDirty(idx);
+	}
+
+	void QuadLayer::MarkDirty(int idx) {
+		if (dirtyBegin == dirtyEnd) {
+			dirtyBegin = idx;
+			dirtyEnd = idx + 1;
+		}
+		else {
+			dirtyBegin = std::min(dirtyBegin, idx);
+			dirtyEnd = std::max(dirtyEnd, idx + 1);
+		}
+	}
+
+	void QuadLayer::TakeUpdate(LayerUpdate& out) {
+		out.size = int(quads.size());
+		if (out.size > recordedCapacity) {
+			//buffer gets reallocated -> whole layer has to be uploaded
+			recordedCapacity = out.size;
+			dirtyBegin = 0;
+			dirtyEnd = out.size;
+		}
+
+		out.begin = dirtyBegin;
+		out.quads.assign(quads.begin() + dirtyBegin, quads.begin() + dirtyEnd);
+		out.textures.assign(textures.begin() + dirtyBegin, textures.begin() + dirtyEnd);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	void QuadLayer::Apply(LayerUpdate& update) {
+		//texture slots are assigned per layer (whole layer uploaded -> assigned anew)
+		if (data.useSlots && update.begin == 0 && int(update.quads.size()) == update.size) {
+			slotTextures.clear();
+		}
+
+		for (int i = 0; i < int(update.quads.size()); i++) {
+			const ITexture* texture = update.textures[i];
+			if (texture == nullptr)
+				continue;
+
+			if (data.backend == Backend::Software) {
+				update.quads[i].textureHandle = SoftRegisterTexture(texture);
+			}
+			else if (data.useSlots) {
+				GLuint name = texture->UnderlyingHandle();
+				auto it = std::find(slotTextures.begin(), slotTextures.end(), name);
+				if (it == slotTextures.end()) {
+					ASSERT_MSG(int(slotTextures.size()) < textureSlots, "\tRenderer - retained layer uses more than %d textures (texture slots).\n", textureSlots);
+					it = (int(slotTextures.size()) < textureSlots) ? slotTextures.insert(slotTextures.end(), name) : slotTextures.end() - 1;
+				}
+				update.quads[i].textureHandle = uint64_t(it - slotTextures.begin()) + 1;
+			}
+			else {
+				update.quads[i].textureHandle = texture->BindlessHandle();
+			}
+		}
+
+		if (data.backend == Backend::Software) {
+			softQuads.resize(update.size);
+			std::copy(update.quads.begin(), update.quads.end(), softQuads.begin() + update.begin);
+			capacity = std::max(capacity, update.size);
+			return;
+		}
+
+		if (update.size > capacity) {
+			//(re)allocation (update contains the whole layer)
+			if (vbo == 0) {
+				glGenVertexArrays(1, &vao);
+			}
+			else {
+				glDeleteBuffers(1, &vbo);
+			}
+			capacity = update.size;
+
+			glBindVertexArray(vao);
+			glGenBuffers(1, &vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferStorage(GL_ARRAY_BUFFER, sizeof(Quad) * capacity, update.quads.data(), GL_DYNAMIC_STORAGE_BIT);
+			SetupInstanceAttributes();
+		}
+		else if (!update.quads.empty()) {
+			glNamedBufferSubData(vbo, sizeof(Quad) * update.begin, sizeof(Quad) * update.quads.size(), update.quads.data());
+		}
+	}
+
+	//===== software backend =====
+
+	SoftRaster::Image& SoftScreen() {
+		Window& window = Window::Get();
+		if (data.screen.width != window.Width() || data.screen.height != window.Height()) {
+			data.screen.Resize(window.Width(), window.Height());
+		}
+		return data.screen;
+	}
+
+	//CPU image only covers the framebuffer's viewport (-> sampled as a whole, no UV scaling needed; shrinking keeps the allocation).
+	SoftRaster::Image& SoftFramebuffer(const Framebuffer* fbo) {
+		SoftRaster::Image& image = data.softTargets[fbo];
+		if (image.width != fbo->ViewportWidth() || image.height != fbo->ViewportHeight()) {
+			image.Resize(fbo->ViewportWidth(), fbo->ViewportHeight());
+		}
+
+		//quads sampling the fbo's texture read the CPU image instead
+		const TextureRef& texture = fbo->GetTexture();
+		image.repeat = (texture->Params().wrapping == GL_REPEAT);
+		data.softImages[texture->Handle()] = &image;
+		return image;
+	}
+
+	//Reads the texture back into the CPU memory (once - textures don't change after their creation; render targets are registered by SoftFramebuffer()).
+	//Returns the GL name of the sampled texture (atlas for the SubTextures), that the quads reference.
+	uint64_t SoftRegisterTexture(const ITexture* texture) {
+		const Texture* source = dynamic_cast<const Texture*>(texture);
+		if (source == nullptr) {
+			const SubTexture* sub = dynamic_cast<const SubTexture*>(texture);
+			ASSERT_MSG(sub != nullptr, "\tRenderer - unknown texture type (software backend).\n");
+			source = sub->GetAtlas();
+		}
+
+		uint64_t name = source->Handle();
+		if (data.softImages.count(name))
+			return name;
+
+		SoftRaster::Image& image = data.softTextures[name];
+		image.Resize(source->Width(), source->Height());
+		image.repeat = (source->Params().wrapping == GL_REPEAT);
+		glGetTextureImage(source->Handle(), 0, GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(image.pixels.size() * sizeof(uint32_t)), image.pixels.data());
+		data.softImages[name] = &image;
+		return name;
+	}
+
+	//Rasterizes the quads into the current render target.
+	void SoftDraw(const Quad* quads, int count) {
+		SoftRaster::Image& target = (data.fbo != nullptr) ? SoftFramebuffer(data.fbo.get()) : SoftScreen();
+
+		//resolve the handles (consecutive quads mostly share the texture)
+		data.softBatchImages.resize(count);
+		uint64_t lastHandle = 0;
+		const SoftRaster::Image* lastImage = nullptr;
+		for (int i = 0; i < count; i++) {
+			uint64_t handle = quads[i].textureHandle;
+			if (handle != lastHandle) {
+				auto it = data.softImages.find(handle);
+				lastImage = (it != data.softImages.end()) ? it->second : nullptr;
+				lastHandle = handle;
+			}
+			data.softBatchImages[i] = (handle != 0) ? lastImage : nullptr;
+		}
+
+		data.raster->Draw(target, quads, data.softBatchImages.data(), count);
+	}
+
+	//Uploads the CPU rendered screen & copies it into the default framebuffer.
+	void SoftPresent() {
+		SoftRaster::Image& screen = SoftScreen();
+
+		GLint width = 0, height = 0;
+		if (data.screenTexture != 0) {
+			glGetTextureLevelParameteriv(data.screenTexture, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTextureLevelParameteriv(data.screenTexture, 0, GL_TEXTURE_HEIGHT, &height);
+		}
+		if (width != screen.width || height != screen.height) {
+			if (data.screenFbo != 0) {
+				glDeleteFramebuffers(1, &data.screenFbo);
+				glDeleteTextures(1, &data.screenTexture);
+			}
+			glCreateTextures(GL_TEXTURE_2D, 1, &data.screenTexture);
+			glTextureStorage2D(data.screenTexture, 1, GL_RGBA8, screen.width, screen.height);
+			glCreateFramebuffers(1, &data.screenFbo);
+			glNamedFramebufferTexture(data.screenFbo, GL_COLOR_ATTACHMENT0, data.screenTexture, 0);
+		}
+
+		glTextureSubImage2D(data.screenTexture, 0, 0, 0, screen.width, screen.height, GL_RGBA, GL_UNSIGNED_BYTE, screen.pixels.data());
+
+		Framebuffer::Unbind();
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, data.screenFbo);
+		glBlitFramebuffer(0, 0, screen.width, screen.height, 0, 0, screen.width, screen.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		Framebuffer::Unbind();
+	}
+
+	//===== frame packets =====
+
+	FramePacketRef CreatePacket() {
+		return std::make_shared<FramePacket>();
+	}
+
+	void BeginRecording(const FramePacketRef& packet) {
+		ASSERT_MSG(recording == nullptr, "\tRenderer - already recording into a frame packet.\n");
+		recording = packet.get();
+
+		recording->ops.clear();
+		recording->quads.clear();
+		recording->textures.clear();
+		recording->shaders.clear();
+		recording->fbos.clear();
+		recording->layers.clear();
+		recording->calls.clear();
+		recording->passes.clear();
+	}
+
+	void EndRecording() {
+		recording = nullptr;
+	}
+
+	void Replay(const FramePacketRef& packet) {
+		FramePacket& p = *packet;
+		for (const PacketOp& op : p.ops) {
+			switch (op.type) {
+				case Op_Begin:		ExecBegin(op.arg != 0, p.passes[op.payload]); break;
+				case Op_End:		ExecEnd(); break;
+				case Op_Flush:		ExecFlush(Flush_Explicit); break;
+				case Op_EndFrame:	ExecEndFrame(); break;
+				case Op_SetShader:	ExecSetShader(p.shaders[op.payload]); break;
+				case Op_SetLayer:	data.layer = op.arg; break;
+				case Op_UseFBO:		data.fbo = p.fbos[op.payload]; break;
+				case Op_Layer:		ExecRenderLayer(std::move(p.layers[op.payload])); break;
+				case Op_Call:		p.calls[op.payload](); break;
+				case Op_Quads:
+					for (int i = op.payload; i < op.payload + op.count; i++) {
+						ExecSubmit(p.quads[i], p.textures[i]);
+					}
+					break;
+			}
+		}
+	}
+
 }//namespace Renderer
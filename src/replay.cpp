@@ -0,0 +1,176 @@
+#include "breakout/replay.h"
+#include "breakout/log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Game {
+
+	//File layout (native byte order, no padding):
+	//	header:	magic[4], u16 version, u32 seed, f32 tickRate, i32 stressBalls, u32 tickCount
+	//	levels:	u16 count, then per level: u16 length + path chars
+	//	events:	u32 count, then per event: u32 tick, u8 type, u8 value
+#define REPLAY_MAGIC "BRKR"
+#define REPLAY_VERSION 1
+
+	template <typename T>
+	static void Write(FILE* f, const T& value) {
+		fwrite(&value, sizeof(T), 1, f);
+	}
+
+	template <typename T>
+	static bool Read(FILE* f, T& out_value) {
+		return fread(&out_value, sizeof(T), 1, f) == 1;
+	}
+
+	void Replay::Begin(uint32_t seed_, float tickRate_, int stressBalls_, const std::vector<std::string>& levels_) {
+		seed = seed_;
+		tickRate = tickRate_;
+		stressBalls = stressBalls_;
+		levels = levels_;
+
+		events.clear();
+		tickCount = 0;
+		Rewind();
+	}
+
+	void Replay::RecordTick(uint32_t tick, const SimInput& input, bool launch) {
+		if (input.left != lastInput.left)
+			RecordEvent(tick, InputEventType::Left, input.left);
+		if (input.right != lastInput.right)
+			RecordEvent(tick, InputEventType::Right, input.right);
+		if (launch)
+			RecordEvent(tick, InputEventType::Launch);
+		lastInput = input;
+	}
+
+	void Replay::RecordEvent(uint32_t tick, InputEventType type, uint8_t value) {
+		events.push_back({ tick, type, value });
+	}
+
+	void Replay::End(uint32_t tickCount_) {
+		tickCount = tickCount_;
+	}
+
+	void Replay::Rewind() {
+		cursor = 0;
+		lastInput = {};
+	}
+
+	bool Replay::PopNewGame(uint32_t tick) {
+		if (cursor < events.size() && events[cursor].tick <= tick && events[cursor].type == InputEventType::NewGame) {
+			cursor++;
+			return true;
+		}
+		return false;
+	}
+
+	void Replay::PlaybackTick(uint32_t tick, SimInput& out_input, bool& out_launch) {
+		out_launch = false;
+		for (; cursor < events.size() && events[cursor].tick <= tick; cursor++) {
+			const InputEvent& e = events[cursor];
+			switch (e.type) {
+				case InputEventType::Left:
+					out_input.left = (e.value != 0);
+					break;
+				case InputEventType::Right:
+					out_input.right = (e.value != 0);
+					break;
+				case InputEventType::Launch:
+					out_launch = true;
+					break;
+				case InputEventType::NewGame:
+					return;
+			}
+		}
+	}
+
+	bool Replay::Save(const char* filepath) const {
+		FILE* f = fopen(filepath, "wb");
+		if (f == nullptr) {
+			LOG(LOG_ERROR, "Replay - Failed to open '%s' for writing.\n", filepath);
+			return false;
+		}
+
+		fwrite(REPLAY_MAGIC, 1, 4, f);
+		Write(f, uint16_t(REPLAY_VERSION));
+		Write(f, seed);
+		Write(f, tickRate);
+		Write(f, int32_t(stressBalls));
+		Write(f, tickCount);
+
+		Write(f, uint16_t(levels.size()));
+		for (const std::string& level : levels) {
+			Write(f, uint16_t(level.size()));
+			fwrite(level.data(), 1, level.size(), f);
+		}
+
+		Write(f, uint32_t(events.size()));
+		for (const InputEvent& e : events) {
+			Write(f, e.tick);
+			Write(f, uint8_t(e.type));
+			Write(f, e.value);
+		}
+
+		bool success = (ferror(f) == 0);
+		fclose(f);
+
+		if (success) {
+			LOG(LOG_INFO, "Replay - Saved '%s' (%d ticks, %d events).\n", filepath, (int)tickCount, (int)events.size());
+		}
+		else {
+			LOG(LOG_ERROR, "Replay - Failed to write '%s'.\n", filepath);
+		}
+		return success;
+	}
+
+	bool Replay::Load(const char* filepath) {
+		FILE* f = fopen(filepath, "rb");
+		if (f == nullptr) {
+			LOG(LOG_ERROR, "Replay - Failed to open '%s'.\n", filepath);
+			return false;
+		}
+
+		char magic[4];
+		uint16_t version = 0;
+		int32_t stress = 0;
+		bool valid = fread(magic, 1, 4, f) == 4 && memcmp(magic, REPLAY_MAGIC, 4) == 0 && Read(f, version) && version == REPLAY_VERSION;
+		valid = valid && Read(f, seed) && Read(f, tickRate) && Read(f, stress) && Read(f, tickCount);
+		stressBalls = stress;
+
+		uint16_t levelCount = 0;
+		valid = valid && Read(f, levelCount);
+		levels.clear();
+		for (int i = 0; valid && i < levelCount; i++) {
+			uint16_t length = 0;
+			valid = Read(f, length);
+			std::string level(length, '\0');
+			valid = valid && fread(&level[0], 1, length, f) == length;
+			levels.push_back(std::move(level));
+		}
+
+		uint32_t eventCount = 0;
+		valid = valid && Read(f, eventCount);
+		events.clear();
+		for (uint32_t i = 0; valid && i < eventCount; i++) {
+			InputEvent e;
+			uint8_t type = 0;
+			valid = Read(f, e.tick) && Read(f, type) && Read(f, e.value) && type <= uint8_t(InputEventType::NewGame);
+			e.type = InputEventType(type);
+			events.push_back(e);
+		}
+		fclose(f);
+
+		if (!valid || tickRate <= 0.f) {
+			LOG(LOG_ERROR, "Replay - '%s' is not a valid replay file.\n", filepath);
+			events.clear();
+			levels.clear();
+			return false;
+		}
+
+		Rewind();
+		LOG(LOG_INFO, "Replay - Loaded '%s' (%d ticks, %d events, seed %u).\n", filepath, (int)tickCount, (int)events.size(), seed);
+		return true;
+	}
+
+}//namespace Game
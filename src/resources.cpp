@@ -1,5 +1,7 @@
 #include "breakout/resources.h"
 
+#include "breakout/log.h"
+
 namespace Resources {
 
 	std::map<std::string, ShaderRef> shaders;
@@ -19,6 +21,21 @@ namespace Resources {
 		textures.clear();
 	}
 
+	void WaitForShaders() {
+		int cached = 0;
+		int compiled = 0;
+		for (auto& [key, shader] : shaders) {
+			if (shader->FromCache()) {
+				cached++;
+			}
+			else {
+				shader->Finalize();
+				compiled++;
+			}
+		}
+		LOG(LOG_RESOURCE, "Resources - shaders ready (%d from the binary cache, %d compiled).\n", cached, compiled);
+	}
+
 	void AddShader(const std::string& key, ShaderRef& shader) {
 		shaders[key] = shader;
 	}
@@ -3,9 +3,31 @@
 #include "breakout/log.h"
 #include "breakout/utils.h"
 
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <filesystem>
+
+#define SHADER_CACHE_DIR "shader_cache/"
+#define SHADER_CACHE_MAGIC "BRKS"
+
+//GL_KHR_parallel_shader_compile (not part of the generated loader)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
 
 GLuint CompileSource(const char* source, GLenum shaderType);
-GLuint LinkProgram(GLuint vertex, GLuint fragment);
+bool CheckCompileStatus(GLuint shader, GLenum shaderType);
+bool CheckLinkStatus(GLuint program);
+bool ParallelCompileSupported();
+uint64_t ProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines);
+std::string PermutationName(const std::string& name, const std::vector<std::string>& defines);
+GLuint LoadProgramBinary(const std::string& filepath);
+void SaveProgramBinary(GLuint program, const std::string& filepath);
 
 //===== Shader =====
 
@@ -19,17 +41,77 @@ Shader::Shader(const std::string& filepath) : Shader(filepath + ".vert", filepat
 Shader::Shader(const std::string& vertexFilepath, const std::string& fragmentFilepath) 
 	: Shader(ReadFile(vertexFilepath.c_str()), ReadFile(fragmentFilepath.c_str()), fragmentFilepath.substr(0, fragmentFilepath.size() - 5)) {}
 
+Shader::Shader(const std::string& vertexFilepath, const std::string& fragmentFilepath, const std::vector<std::string>& defines)
+	: Shader(InjectDefines(ReadFile(vertexFilepath.c_str()), defines), InjectDefines(ReadFile(fragmentFilepath.c_str()), defines), PermutationName(fragmentFilepath.substr(0, fragmentFilepath.size() - 5), defines)) {}
+
 Shader::Shader(const std::string& vertexSource, const std::string& fragmentSource, const std::string& name_) : name(name_) {
-	GLuint vertex = CompileSource(vertexSource.c_str(), GL_VERTEX_SHADER);
-	GLuint fragment = CompileSource(fragmentSource.c_str(), GL_FRAGMENT_SHADER);
+	char buf[64];
+	snprintf(buf, sizeof(buf), SHADER_CACHE_DIR "%016llx.bin", (unsigned long long)ProgramCacheKey(vertexSource, fragmentSource));
+	cachePath = buf;
 
-	program = LinkProgram(vertex, fragment);
+	//warm start - program binary from the previous run (same sources & driver)
+	program = LoadProgramBinary(cachePath);
+	if (program != 0) {
+		fromCache = true;
+		ReflectUniforms();
+		LOG(LOG_RESOURCE, "Shader '%s' loaded from the program binary cache.\n", name.c_str());
+		LOG(LOG_CTOR, "[C] Shader '%s' (%d)\n", name.c_str(), program);
+		return;
+	}
+
+	//cold start - compilation & linking is only issued here, results are checked in Finalize()
+	bool parallel = ParallelCompileSupported();
+	vertex = CompileSource(vertexSource.c_str(), GL_VERTEX_SHADER);
+	fragment = CompileSource(fragmentSource.c_str(), GL_FRAGMENT_SHADER);
+
+	program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	pending = true;
+	LOG(LOG_CTOR, "[C] Shader '%s' (%d)\n", name.c_str(), program);
+
+	//without the driver's compiler threads, there's nothing to overlap with
+	if (!parallel) {
+		Finalize();
+	}
+}
 
+bool Shader::IsReady() const {
+	if (!pending)
+		return true;
+	if (!ParallelCompileSupported())
+		return false;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+	return (done == GL_TRUE);
+}
+
+void Shader::Finalize() {
+	if (!pending)
+		return;
+	pending = false;
+
+	//status queries block until the driver is done
+	bool success = CheckCompileStatus(vertex, GL_VERTEX_SHADER) && CheckCompileStatus(fragment, GL_FRAGMENT_SHADER) && CheckLinkStatus(program);
+
+	glDetachShader(program, vertex);
+	glDetachShader(program, fragment);
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+	vertex = fragment = 0;
 
+	if (!success) {
+		LOG(LOG_WARN, "Shader '%s' failed to compile.\n", name.c_str());
+		Release();
+		throw std::exception();
+	}
+
+	ReflectUniforms();
+	SaveProgramBinary(program, cachePath);
 	LOG(LOG_RESOURCE, "Shader '%s' successfully compiled & linked.\n", name.c_str());
-	LOG(LOG_CTOR, "[C] Shader '%s' (%d)\n", name.c_str(), program);
 }
 
 Shader::~Shader() {
@@ -48,6 +130,7 @@ Shader& Shader::operator=(Shader&& s) noexcept {
 
 void Shader::Bind() const {
 	SHADER_VALIDATION_CHECK();
+	ASSERT_MSG(!pending, "\tShader '%s' has to be finalized before use.\n", name.c_str());
 	DBG_ONLY(activeProgram = program);
 
 	glUseProgram(program);
@@ -62,70 +145,117 @@ void Shader::Unbind() {
 void Shader::SetVec2(const char* varName, const glm::vec2& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform2fv(glGetUniformLocation(program, varName), 1, (const GLfloat*)&value);
+	glUniform2fv(Location(varName), 1, (const GLfloat*)&value);
 }
 
 void Shader::SetVec3(const char* varName, const glm::vec3& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform3fv(glGetUniformLocation(program, varName), 1, (const GLfloat*)&value);
+	glUniform3fv(Location(varName), 1, (const GLfloat*)&value);
 }
 
 void Shader::SetVec4(const char* varName, const glm::vec4& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform4fv(glGetUniformLocation(program, varName), 1, (const GLfloat*)&value);
+	glUniform4fv(Location(varName), 1, (const GLfloat*)&value);
 }
 
 void Shader::SetMat2(const char* varName, const glm::mat2& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniformMatrix2fv(glGetUniformLocation(program, varName), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix2fv(Location(varName), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::SetMat3(const char* varName, const glm::mat3& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniformMatrix3fv(glGetUniformLocation(program, varName), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix3fv(Location(varName), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::SetMat4(const char* varName, const glm::mat4& value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniformMatrix4fv(glGetUniformLocation(program, varName), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(Location(varName), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::SetInt(const char* varName, int value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform1i(glGetUniformLocation(program, varName), value);
+	glUniform1i(Location(varName), value);
 }
 
 void Shader::SetBool(const char* varName, bool value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform1i(glGetUniformLocation(program, varName), (int)value);
+	glUniform1i(Location(varName), (int)value);
 }
 
 void Shader::SetFloat(const char* varName, float value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform1f(glGetUniformLocation(program, varName), value);
+	glUniform1f(Location(varName), value);
 }
 
 void Shader::SetUint(const char* varName, unsigned int value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniform1ui(glGetUniformLocation(program, varName), value);
+	glUniform1ui(Location(varName), value);
 }
 
 void Shader::SetARBHandle(const char* varName, uint64_t value) const {
 	SHADER_VALIDATION_CHECK();
 	ACTIVE_SHADER_VALIDATION_CHECK();
-	glUniformHandleui64ARB(glGetUniformLocation(program, varName), value);
+	glUniformHandleui64ARB(Location(varName), value);
+}
+
+GLint Shader::Location(const char* varName) const {
+	auto it = uniforms.find(varName);
+	return (it != uniforms.end()) ? it->second : -1;
+}
+
+void Shader::ReflectUniforms() {
+	uniforms.clear();
+
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::string buf;
+	buf.resize(maxLength + 1);
+	for (int i = 0; i < count; i++) {
+		GLint size;
+		GLenum type;
+		GLsizei length;
+		glGetActiveUniform(program, i, maxLength + 1, &length, &size, &type, &buf[0]);
+		std::string varName = buf.substr(0, length);
+
+		//uniform block members have no location
+		GLint location = glGetUniformLocation(program, varName.c_str());
+		if (location < 0)
+			continue;
+		uniforms[varName] = location;
+
+		//arrays are reported as "name[0]" - make the bare name & all the elements available as well
+		if (length > 3 && varName.compare(length - 3, 3, "[0]") == 0) {
+			std::string baseName = varName.substr(0, length - 3);
+			uniforms[baseName] = location;
+			for (int j = 1; j < size; j++) {
+				std::string elemName = baseName + "[" + std::to_string(j) + "]";
+				uniforms[elemName] = glGetUniformLocation(program, elemName.c_str());
+			}
+		}
+	}
+
+	LOG(LOG_FINE, "Shader '%s' - %d active uniforms.\n", name.c_str(), (int)uniforms.size());
 }
 
 void Shader::Release() noexcept {
+	if (vertex != 0) {
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		vertex = fragment = 0;
+	}
 	if (program != 0) {
 		LOG(LOG_DTOR, "[D] Shader '%s' (%d)\n", name.c_str(), program);
 		glDeleteProgram(program);
@@ -136,18 +266,52 @@ void Shader::Release() noexcept {
 void Shader::Move(Shader&& s) noexcept {
 	program = s.program;
 	name = s.name;
+	uniforms = std::move(s.uniforms);
+	cachePath = std::move(s.cachePath);
+	vertex = s.vertex;
+	fragment = s.fragment;
+	pending = s.pending;
+	fromCache = s.fromCache;
 
 	s.program = 0;
+	s.vertex = s.fragment = 0;
+	s.pending = false;
+}
+
+//===== UniformBuffer =====
+
+UniformBuffer::UniformBuffer(int size_, int binding_, const void* data) : size(size_), binding(binding_) {
+	glCreateBuffers(1, &handle);
+	glNamedBufferStorage(handle, size, data, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+
+	LOG(LOG_CTOR, "[C] UniformBuffer %d (binding %d)\n", handle, binding);
+}
+
+UniformBuffer::~UniformBuffer() {
+	if (handle != 0) {
+		LOG(LOG_DTOR, "[D] UniformBuffer %d\n", handle);
+		glDeleteBuffers(1, &handle);
+		handle = 0;
+	}
+}
+
+void UniformBuffer::Update(const void* data, int size_, int offset) {
+	ASSERT_MSG(offset + size_ <= size, "\tUniformBuffer - update out of bounds (%d + %d > %d).\n", offset, size_, size);
+	glNamedBufferSubData(handle, offset, size_, data);
 }
 
 //===== Utility functions =====
 
 GLuint CompileSource(const char* source, GLenum shaderType) {
-	const char* shaderTypeStr = (shaderType == GL_FRAGMENT_SHADER) ? "Fragment" : "Vertex";
-
 	GLuint shader = glCreateShader(shaderType);
 	glShaderSource(shader, 1, &source, nullptr);
 	glCompileShader(shader);
+	return shader;
+}
+
+bool CheckCompileStatus(GLuint shader, GLenum shaderType) {
+	const char* shaderTypeStr = (shaderType == GL_FRAGMENT_SHADER) ? "Fragment" : "Vertex";
 
 	int success;
 	char infoLog[512];
@@ -156,30 +320,158 @@ GLuint CompileSource(const char* source, GLenum shaderType) {
 	if (!success) {
 		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
 		LOG(LOG_DEBUG, "Shader::CompileSource - %s shader failed to compile:\n%s", shaderTypeStr, infoLog);
-		throw std::exception();
+		return false;
 	}
 
 	LOG(LOG_FINE, "%s shader successfully compiled.\n", shaderTypeStr);
-	return shader;
+	return true;
 }
 
-GLuint LinkProgram(GLuint vertex, GLuint fragment) {
-	GLuint shader = glCreateProgram();
-	glAttachShader(shader, vertex);
-	glAttachShader(shader, fragment);
-	glLinkProgram(shader);
-
+bool CheckLinkStatus(GLuint program) {
 	int success;
 	char infoLog[512];
 
-	glGetProgramiv(shader, GL_LINK_STATUS, &success);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
 	if (!success) {
-		glGetProgramInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
 		LOG(LOG_DEBUG, "Shader::LinkProgram - Program failed to link:\n%s", infoLog);
-		glDeleteProgram(shader);
-		throw std::exception();
+		return false;
 	}
 
 	LOG(LOG_FINE, "Shader successfully linked\n");
-	return shader;
-}
\ No newline at end of file
+	return true;
+}
+
+bool ParallelCompileSupported() {
+	static int supported = -1;
+	if (supported < 0) {
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = nullptr;
+		if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+			glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		}
+
+		supported = (glMaxShaderCompilerThreadsKHR != nullptr);
+		if (supported) {
+			//thread count is up to the driver
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		}
+		LOG(LOG_INFO, "Parallel shader compilation: %s\n", supported ? "on" : "not supported");
+	}
+	return supported != 0;
+}
+
+//#version has to stay the first directive -> defines go right after it.
+std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines) {
+	size_t pos = 0;
+	if (source.compare(0, 8, "#version") == 0) {
+		pos = source.find('\n');
+		pos = (pos == std::string::npos) ? source.size() : pos + 1;
+	}
+
+	std::string block;
+	for (const std::string& define : defines) {
+		block += "#define " + define + "\n";
+	}
+	if (pos > 0) {
+		block += "#line 2\n";		//keeps the line numbers of the compile errors
+	}
+
+	std::string result = source.substr(0, pos);
+	if (pos == source.size() && !result.empty() && result.back() != '\n') {
+		result += '\n';
+	}
+	return result + block + source.substr(pos);
+}
+
+//Permutation label for the logs, e.g. "res/shaders/postproc_shader[EFFECT 1]".
+std::string PermutationName(const std::string& name, const std::vector<std::string>& defines) {
+	std::string result = name + "[";
+	for (size_t i = 0; i < defines.size(); i++) {
+		result += (i > 0 ? ", " : "") + defines[i];
+	}
+	return result + "]";
+}
+
+//FNV-1a over both sources & the driver identification (binaries are only valid for the driver, that produced them).
+uint64_t ProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource) {
+	uint64_t hash = 14695981039346656037ull;
+	auto Hash = [&hash](const char* str) {
+		for (const char* c = str; *c; c++) {
+			hash = (hash ^ uint8_t(*c)) * 1099511628211ull;
+		}
+		hash = (hash ^ 0xFF) * 1099511628211ull;		//separator
+	};
+
+	Hash(vertexSource.c_str());
+	Hash(fragmentSource.c_str());
+	Hash((const char*)glGetString(GL_VENDOR));
+	Hash((const char*)glGetString(GL_RENDERER));
+	Hash((const char*)glGetString(GL_VERSION));
+	return hash;
+}
+
+GLuint LoadProgramBinary(const std::string& filepath) {
+	FILE* f = fopen(filepath.c_str(), "rb");
+	if (f == nullptr)
+		return 0;
+
+	char magic[4];
+	uint32_t format = 0;
+	uint32_t length = 0;
+	std::vector<char> binary;
+
+	bool valid = (fread(magic, 1, 4, f) == 4 && memcmp(magic, SHADER_CACHE_MAGIC, 4) == 0);
+	valid = valid && fread(&format, sizeof(format), 1, f) == 1 && fread(&length, sizeof(length), 1, f) == 1;
+	if (valid) {
+		binary.resize(length);
+		valid = (fread(binary.data(), 1, length, f) == length);
+	}
+	fclose(f);
+
+	if (!valid) {
+		LOG(LOG_WARN, "Shader cache - '%s' is corrupted.\n", filepath.c_str());
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, GLenum(format), binary.data(), GLsizei(length));
+
+	//driver can reject the binary (update, different GPU, ...) -> recompile
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		LOG(LOG_INFO, "Shader cache - binary '%s' rejected by the driver.\n", filepath.c_str());
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void SaveProgramBinary(GLuint program, const std::string& filepath) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	std::error_code ec;
+	std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+
+	FILE* f = fopen(filepath.c_str(), "wb");
+	if (f == nullptr) {
+		LOG(LOG_WARN, "Shader cache - failed to open '%s' for writing.\n", filepath.c_str());
+		return;
+	}
+
+	uint32_t format32 = uint32_t(format);
+	uint32_t length32 = uint32_t(length);
+	fwrite(SHADER_CACHE_MAGIC, 1, 4, f);
+	fwrite(&format32, sizeof(format32), 1, f);
+	fwrite(&length32, sizeof(length32), 1, f);
+	fwrite(binary.data(), 1, length, f);
+	fclose(f);
+}
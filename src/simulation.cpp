@@ -0,0 +1,466 @@
+#include "breakout/simulation.h"
+
+#include "breakout/log.h"
+#include "breakout/utils.h"
+#include "breakout/trace.h"
+
+#include <string.h>
+
+namespace Game {
+
+#define MAX_BOUNCES_PER_STEP 16
+#define CONTACT_SKIN 1e-5f		//separation after collision resolution (so that the next sweep doesn't start in contact)
+
+#define MULTIBALL_SPREAD_RAD 0.4f
+
+	//Ball contacts found by the sweep.
+	enum class ContactType { None, Brick, Platform, WallSide, WallTop, WallBottom };
+
+	//===== Simulation =====
+
+	bool Simulation::LoadLevel(const char* filepath) {
+		//load level description file
+		std::string levelDesc;
+		if (!TryReadFile(filepath, levelDesc)) {
+			LOG(LOG_ERROR, "Level loading failed.\n");
+			return false;
+		}
+
+		ParseLevel(levelDesc);
+
+		LOG(LOG_INFO, "Loaded level from '%s'.\n", filepath);
+		return true;
+	}
+
+	void Simulation::ParseLevel(const std::string& levelDesc) {
+		//previous level cleanup
+		bricks.Clear();
+		fieldSize = glm::ivec2(0);
+
+		//parse level data
+		std::string::size_type prevPos = 0, pos = 0;
+		while ((pos = levelDesc.find('\n', pos)) != std::string::npos) {
+			std::string_view s = std::string_view(levelDesc.c_str() + prevPos, pos - prevPos);
+			prevPos = ++pos;
+
+			//playing field size update
+			int rowLen = s.size() / 2;
+			if (fieldSize.x < rowLen)
+				fieldSize.x = rowLen;
+			if (s.size() > 1)
+				fieldSize.y++;
+			else
+				continue;
+
+			//parse bricks in this row
+			for (size_t i = 0; i < s.size() / 2; i++) {
+				char color = s[i * 2];
+				char type = s[i * 2 + 1];
+
+				int c = 1;
+				int t = BrickType::Brick;
+
+				//empty space
+				if (type == ' ' || type == '0')
+					continue;
+
+				//read block color (or keep default if invalid)
+				if (color >= '1' && color <= '9') {
+					c = int(color - '0');
+				}
+
+				//block type resolution
+				const char* code = strchr(BrickType::BrickCodes(), type);
+				if (code != nullptr) {
+					t = int(code - BrickType::BrickCodes());
+					bricks.Add(int(i), fieldSize.y - 1, t, c);
+				}
+				else {
+					LOG(LOG_WARN, "Invalid brick type ('%c')\n", s[i]);
+				}
+			}
+		}
+
+		//update brick sizes (positions are derived from grid coords)
+		brickSize = glm::vec2(
+			1.f / fieldSize.x,
+			(1.f - fieldOffsetY) / fieldSize.y
+		);
+
+		grid.Build(bricks, fieldSize, brickSize);
+	}
+
+	void Simulation::NewGame() {
+		level = 0;
+		lives = STARTING_LIVES;
+	}
+
+	void Simulation::Reset() {
+		for (Ball& b : balls) {
+			b.speed = DEFAULT_BALL_SPEED;
+		}
+		p.speed = DEFAULT_PLATFORM_SPEED;
+		p.scale = DEFAULT_PLATFORM_SCALE;
+
+		MidGameReset();
+	}
+
+	void Simulation::MidGameReset() {
+		p.pos = 0.f;
+
+		//back to a single ball (keeps its speed)
+		Ball b = balls.empty() ? Ball() : balls[0];
+		b.pos = b.prevPos = glm::vec2(p.pos, PLATFORM_Y_POS + PLATFORM_HEIGHT + b.radius);
+		b.dir = glm::vec2(0.0f, 1.f);
+		b.onPlatform = true;
+		balls.assign(1, b);
+		spawned.clear();
+
+		effects.wallBreaker = false;
+		effects.platformSticking = false;
+		effects.postprocEffect = PostProcEffectType::None;
+	}
+
+	void Simulation::LaunchBall() {
+		for (Ball& b : balls) {
+			b.onPlatform = false;
+		}
+	}
+
+	void Simulation::SpawnBalls(int count) {
+		count = glm::min(count, MAX_BALLS - int(balls.size()));
+		if (count <= 0)
+			return;
+
+		Ball b = balls.empty() ? Ball() : balls[0];
+		b.onPlatform = false;
+
+		//fan of balls above the platform (golden ratio sequence -> evenly spread, deterministic)
+		balls.reserve(balls.size() + count);
+		for (int i = 0; i < count; i++) {
+			float f = glm::fract(i * 0.618034f);
+			float angle = glm::radians(30.f + 120.f * f);
+
+			b.pos = b.prevPos = glm::vec2(p.pos + p.scale * (1.f - 2.f * f), PLATFORM_Y_POS + PLATFORM_HEIGHT + b.radius + 1e-3f);
+			b.dir = glm::vec2(cosf(angle), sinf(angle));
+			balls.push_back(b);
+		}
+	}
+
+	void Simulation::Update(float deltaTime, const SimInput& input) {
+		float prevPos = p.pos;
+
+		events.clear();
+		time += deltaTime;
+
+		//input processing - platform movement
+		if (input.left || input.right) {
+			float move = (float(input.right) - float(input.left)) * p.speed;
+			p.pos += move * deltaTime;
+
+			//platform movement clamping
+			if (p.pos < -0.98f + p.scale)
+				p.pos = -0.98f + p.scale;
+			if (p.pos > 0.98f - p.scale)
+				p.pos = 0.98f - p.scale;
+		}
+
+		//balls update
+		TRACE_ZONE("CollisionResolution");
+		for (Ball& b : balls) {
+			b.prevPos = b.pos;
+		}
+		for (int i = 0; i < int(balls.size());) {
+			Ball& b = balls[i];
+
+			if (b.onPlatform) {
+				//stick to the platform
+				float ballXOffset = b.pos.x - prevPos;
+				b.pos = glm::vec2(p.pos + ballXOffset, PLATFORM_Y_POS + PLATFORM_HEIGHT + b.radius);
+			}
+			else if (BallMovement(b, deltaTime)) {
+				//ball fell out -> remove it, unless it's the last one
+				if (balls.size() + spawned.size() > 1) {
+					balls[i] = balls.back();
+					balls.pop_back();
+					continue;
+				}
+
+				//last ball lost -> player loses life
+				if ((--lives) <= 0) {
+					Emit(SimEventType::GameOver);
+				}
+				else {
+					Emit(SimEventType::BallLost, lives);
+				}
+			}
+
+			i++;
+		}
+
+		//balls from multi-ball power-ups join in the next step
+		balls.insert(balls.end(), spawned.begin(), spawned.end());
+		spawned.clear();
+
+		//level finished condition check
+		if (bricks.bricksLeft < 1) {
+			level++;
+			Emit(SimEventType::LevelFinished, level);
+		}
+	}
+
+	bool Simulation::BallMovement(Ball& b, float deltaTime) {
+		float distance = b.speed * deltaTime;
+
+		//sweep -> move to the earliest contact -> resolve, repeat with the remaining distance
+		for (int bounce = 0; bounce < MAX_BOUNCES_PER_STEP && distance > 0.f && !b.onPlatform; bounce++) {
+			glm::vec2 delta = b.dir * distance;
+
+			ContactType contact = ContactType::None;
+			float t = 2.f;
+			int brickIdx = -1;
+
+			//bricks - broadphase gathers bricks from the cells overlapped by ball's swept AABB
+			//(row-major iteration order matches the order, in which bricks were created)
+			candidates.Clear();
+			glm::ivec2 from, to;
+			if (grid.CellRange(glm::min(b.pos, b.pos + delta) - b.radius, glm::max(b.pos, b.pos + delta) + b.radius, from, to)) {
+				for (int y = from.y; y <= to.y; y++) {
+					for (int x = from.x; x <= to.x; x++) {
+						int idx = grid.At(x, y);
+						if (idx >= 0) {
+							candidates.Add(idx, bricks.Position(idx, brickSize));
+						}
+					}
+				}
+			}
+
+			//bricks - narrow-phase, batched sweep
+			BrickHit hit;
+			if (Collision::Ball_BricksSweep(b.pos, delta, b.radius, brickSize, candidates, hit)) {
+				contact = ContactType::Brick;
+				t = hit.t;
+				brickIdx = hit.brickIdx;
+			}
+
+			//platform
+			float tp;
+			if (Collision::SweptCircle_AABB(b.pos, delta, b.radius, glm::vec2(p.pos, PLATFORM_Y_POS), glm::vec2(p.scale, PLATFORM_HEIGHT), tp) && tp < t) {
+				contact = ContactType::Platform;
+				t = tp;
+			}
+
+			//walls - only the ones the ball is moving towards
+			glm::vec2 wall = glm::vec2((delta.x < 0.f) ? -1.f : 1.f, (delta.y < 0.f) ? -1.f : 1.f) * (1.f - b.radius);
+			if (delta.x != 0.f) {
+				float tw = glm::max((wall.x - b.pos.x) / delta.x, 0.f);
+				if (tw <= 1.f && tw < t) {
+					contact = ContactType::WallSide;
+					t = tw;
+				}
+			}
+			if (delta.y != 0.f) {
+				float tw = glm::max((wall.y - b.pos.y) / delta.y, 0.f);
+				if (tw <= 1.f && tw < t) {
+					contact = (delta.y > 0.f) ? ContactType::WallTop : ContactType::WallBottom;
+					t = tw;
+				}
+			}
+
+			if (contact == ContactType::None) {
+				b.pos += delta;
+				break;
+			}
+
+			//move to the contact & resolve it
+			b.pos += delta * t;
+			distance *= (1.f - t);
+
+			switch (contact) {
+				case ContactType::Brick:
+					BrickContact(b, brickIdx);
+					break;
+				case ContactType::Platform:
+					PlatformContact(b);
+					break;
+				case ContactType::WallSide:
+					b.pos.x = wall.x - glm::sign(wall.x) * CONTACT_SKIN;
+					b.dir.x = -b.dir.x;
+					break;
+				case ContactType::WallTop:
+					b.pos.y = wall.y - CONTACT_SKIN;
+					b.dir.y = -b.dir.y;
+					break;
+				case ContactType::WallBottom:
+					//bottom wall -> ball is lost
+					return true;
+				case ContactType::None:
+					//handled above (no contact -> the whole movement is done)
+					break;
+			}
+		}
+
+		return false;
+	}
+
+	void Simulation::BrickContact(Ball& b, int idx) {
+		int brickDeleteIdx = -1;
+		bool bounce = false;
+		bool multiBall = false;
+		int type = bricks.type[idx];
+
+		switch (type) {
+			default:
+			case BrickType::Brick:
+				Emit(SimEventType::BrickHit, type);
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::Wall:
+				Emit(SimEventType::BrickHit, type);
+				if (effects.wallBreaker) {
+					brickDeleteIdx = idx;
+				}
+				bounce = true;
+				break;
+			case BrickType::PlatformGrow:
+				Emit(SimEventType::PowerUp, type);
+				p.scale *= 2.f;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::PlatformShrink:
+				Emit(SimEventType::PowerUp, type);
+				p.scale *= 0.5f;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::PlatformSticking:
+				Emit(SimEventType::PowerUp, type);
+				effects.platformSticking = true;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::WallBreaker:
+				Emit(SimEventType::PowerUp, type);
+				effects.wallBreaker = true;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::BallSpeedUp:
+				Emit(SimEventType::PowerUp, type);
+				b.speed *= 1.5f;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::BallSlowDown:
+				Emit(SimEventType::PowerUp, type);
+				b.speed *= 0.666666f;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::MultiBall:
+				Emit(SimEventType::PowerUp, type);
+				multiBall = true;
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::EffectBlur:
+				effects.postprocEffect = PostProcEffectType::Blur;
+				Emit(SimEventType::EffectChange, int(effects.postprocEffect));
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::EffectDrunk:
+				effects.postprocEffect = PostProcEffectType::Drunk;
+				Emit(SimEventType::EffectChange, int(effects.postprocEffect));
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::EffectChaos:
+				effects.postprocEffect = PostProcEffectType::Chaos;
+				Emit(SimEventType::EffectChange, int(effects.postprocEffect));
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+			case BrickType::EffectConfuse:
+				effects.postprocEffect = PostProcEffectType::Confuse;
+				Emit(SimEventType::EffectChange, int(effects.postprocEffect));
+				brickDeleteIdx = idx;
+				bounce = true;
+				break;
+		}
+
+		if (bounce) {
+			//push the ball out & reflect its direction (unless it's already moving away)
+			glm::vec2 posFix;
+			glm::vec2 n = Collision::Circle_AABBContact(b.pos, b.radius, bricks.Position(idx, brickSize), brickSize, CONTACT_SKIN, posFix);
+			b.pos += posFix;
+			if (glm::dot(b.dir, n) < 0.f) {
+				b.dir = glm::reflect(b.dir, n);
+			}
+		}
+
+		//2 new balls, flying off at an angle from the hitting one
+		if (multiBall && int(balls.size() + spawned.size()) + 2 <= MAX_BALLS) {
+			float c = cosf(MULTIBALL_SPREAD_RAD);
+			float s = sinf(MULTIBALL_SPREAD_RAD);
+
+			Ball nb = b;
+			nb.dir = glm::vec2(c * b.dir.x - s * b.dir.y, s * b.dir.x + c * b.dir.y);
+			spawned.push_back(nb);
+			nb.dir = glm::vec2(c * b.dir.x + s * b.dir.y, -s * b.dir.x + c * b.dir.y);
+			spawned.push_back(nb);
+		}
+
+		//delete marked brick
+		if (brickDeleteIdx >= 0) {
+			RemoveBrick(brickDeleteIdx);
+		}
+	}
+
+	void Simulation::PlatformContact(Ball& b) {
+		glm::vec2 platformPos = glm::vec2(p.pos, PLATFORM_Y_POS);
+		glm::vec2 platformSize = glm::vec2(p.scale, PLATFORM_HEIGHT);
+
+		//new direction -> based on distance from platform's center
+		glm::vec2 P = glm::clamp(b.pos, platformPos - platformSize, platformPos + platformSize);
+		float f = ((P.x - p.pos) / p.scale) * PLATFORM_BOUNCE_STEEPNESS;
+		b.dir = glm::normalize(glm::vec2(f, 1.f));
+
+		glm::vec2 posFix;
+		Collision::Circle_AABBContact(b.pos, b.radius, platformPos, platformSize, CONTACT_SKIN, posFix);
+		b.pos += posFix;
+
+		if (effects.platformSticking) {
+			b.onPlatform = true;
+		}
+		Emit(SimEventType::PlatformHit);
+	}
+
+	void Simulation::RemoveBrick(int idx) {
+		grid.At(bricks.Coords(idx)) = -1;
+		bricks.Remove(idx);
+		Emit(SimEventType::BrickDestroyed, idx);
+	}
+
+	void Simulation::Emit(SimEventType type, int value) {
+		events.push_back(SimEvent{ type, value });
+	}
+
+	//===== Collision handling =====
+
+	//Collision detection between two AABBs.
+	bool AABB_AABBCollision(const glm::vec2& aPos, const glm::vec2& aSize, const glm::vec2& bPos, const glm::vec2& bSize) {
+		glm::vec2 aMin = aPos - aSize;
+		glm::vec2 aMax = aPos + aSize;
+		glm::vec2 bMin = bPos - bSize;
+		glm::vec2 bMax = bPos + bSize;
+
+		bool xCheck = (aMin.x < bMax.x) && (aMax.x > bMin.x);
+		bool yCheck = (aMin.y < bMax.y) && (aMax.y > bMin.y);
+
+		return (xCheck && yCheck);
+	}
+
+}//namespace Game
@@ -0,0 +1,416 @@
+#include "breakout/soft_raster.h"
+
+#include "breakout/renderer.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BREAKOUT_X86
+#include <immintrin.h>
+#endif
+
+//rows per band (unit of work for the thread pool)
+#define BAND_HEIGHT 16
+
+namespace SoftRaster {
+
+	//===== Image =====
+
+	void Image::Resize(int width_, int height_) {
+		width = width_;
+		height = height_;
+		pixels.resize(size_t(width) * height);
+	}
+
+	void Image::Clear(uint32_t rgba) {
+		std::fill(pixels.begin(), pixels.end(), rgba);
+	}
+
+	//===== shading =====
+
+	//Quad transformed into the target's pixel space.
+	struct QuadSetup {
+		int x0, y0, x1, y1;				//bounding box (end exclusive), clipped to the target
+		float u0, ux, uy;				//quad's local coords (0-1) as affine functions of the pixel center
+		float v0, vx, vy;
+		glm::vec4 texRect;
+		glm::vec4 color;
+		float alphaTexture;
+		const Image* texture;
+		bool skip;						//degenerate, transparent or off screen
+	};
+
+	static inline int WrapCoord(int i, int size, bool repeat) {
+		if (unsigned(i) < unsigned(size))
+			return i;
+		if (repeat) {
+			i %= size;
+			return (i < 0) ? i + size : i;
+		}
+		return (i < 0) ? 0 : size - 1;
+	}
+
+	//Texel addresses & weights of a bilinear lookup (GL_LINEAR).
+	struct BilinearTaps {
+		const uint32_t* t00;
+		const uint32_t* t10;
+		const uint32_t* t01;
+		const uint32_t* t11;
+		float fx, fy;
+	};
+
+	//Floor for the texel coords (cheaper than floorf() without SSE4.1). Far out of range coords get clamped (wrapping gets imprecise there anyway).
+	static inline int FloorCoord(float x) {
+		x = std::min(std::max(x, -1e6f), 1e6f);
+		int i = int(x);
+		return i - (x < float(i));
+	}
+
+	static inline BilinearTaps Taps(const Image& img, float s, float t) {
+		float x = s * img.width - 0.5f;
+		float y = t * img.height - 0.5f;
+		int xi = FloorCoord(x);
+		int yi = FloorCoord(y);
+
+		int x0 = WrapCoord(xi, img.width, img.repeat);
+		int x1 = WrapCoord(xi + 1, img.width, img.repeat);
+		int y0 = WrapCoord(yi, img.height, img.repeat);
+		int y1 = WrapCoord(yi + 1, img.height, img.repeat);
+
+		const uint32_t* row0 = img.pixels.data() + size_t(y0) * img.width;
+		const uint32_t* row1 = img.pixels.data() + size_t(y1) * img.width;
+		return { row0 + x0, row0 + x1, row1 + x0, row1 + x1, x - float(xi), y - float(yi) };
+	}
+
+	static inline glm::vec4 Lerp(const glm::vec4& a, const glm::vec4& b, float t) {
+		return a + (b - a) * t;
+	}
+
+	static glm::vec4 Unpack(uint32_t c) {
+		return glm::vec4(float(c & 0xFF), float((c >> 8) & 0xFF), float((c >> 16) & 0xFF), float(c >> 24)) * (1.f / 255.f);
+	}
+
+	static uint32_t Pack(const glm::vec4& v) {
+		glm::vec4 c = glm::clamp(v, 0.f, 1.f) * 255.f + 0.5f;
+		return uint32_t(c.r) | (uint32_t(c.g) << 8) | (uint32_t(c.b) << 16) | (uint32_t(c.a) << 24);
+	}
+
+	//Reference implementation (one pixel at a time).
+	static glm::vec4 Sample_Scalar(const Image& img, float s, float t) {
+		BilinearTaps b = Taps(img, s, t);
+		glm::vec4 top = Lerp(Unpack(*b.t00), Unpack(*b.t10), b.fx);
+		glm::vec4 bottom = Lerp(Unpack(*b.t01), Unpack(*b.t11), b.fx);
+		return Lerp(top, bottom, b.fy);
+	}
+
+	//basic_quad_shader + glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+	static void ShadeSpan_Scalar(const QuadSetup& q, uint32_t* row, int y, int xBegin, int xEnd) {
+		float cy = y + 0.5f;
+		glm::vec2 tcScale = glm::vec2(q.texRect.z - q.texRect.x, q.texRect.w - q.texRect.y);
+
+		for (int x = xBegin; x < xEnd; x++) {
+			float cx = x + 0.5f;
+			glm::vec4 t = glm::vec4(1.f);
+			if (q.texture != nullptr) {
+				float u = q.u0 + q.ux * cx + q.uy * cy;
+				float v = q.v0 + q.vx * cx + q.vy * cy;
+				t = Sample_Scalar(*q.texture, q.texRect.x + tcScale.x * u, q.texRect.y + tcScale.y * v);
+			}
+
+			glm::vec4 m = (1.f - q.alphaTexture) * t + q.alphaTexture * glm::vec4(1.f, 1.f, 1.f, t.r);
+			glm::vec4 src = q.color * m;
+			glm::vec4 dst = Unpack(row[x]);
+			row[x] = Pack(src * src.a + dst * (1.f - src.a));
+		}
+	}
+
+#ifdef BREAKOUT_X86
+	//Pixel's channels in a single register (SSE2 is part of the x86-64 baseline -> no target attribute needed).
+	static inline __m128 Unpack_SSE(uint32_t c) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(c)), zero), zero);
+		return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.f / 255.f));
+	}
+
+	static inline uint32_t Pack_SSE(__m128 v) {
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+		__m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f)));
+		i = _mm_packs_epi32(i, i);
+		i = _mm_packus_epi16(i, i);
+		return uint32_t(_mm_cvtsi128_si32(i));
+	}
+
+	static inline __m128 Lerp_SSE(__m128 a, __m128 b, __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	static inline __m128 Sample_SSE(const Image& img, float s, float t) {
+		BilinearTaps b = Taps(img, s, t);
+		__m128 fx = _mm_set1_ps(b.fx);
+		__m128 top = Lerp_SSE(Unpack_SSE(*b.t00), Unpack_SSE(*b.t10), fx);
+		__m128 bottom = Lerp_SSE(Unpack_SSE(*b.t01), Unpack_SSE(*b.t11), fx);
+		return Lerp_SSE(top, bottom, _mm_set1_ps(b.fy));
+	}
+
+	static void ShadeSpan_SSE(const QuadSetup& q, uint32_t* row, int y, int xBegin, int xEnd) {
+		const __m128 color = _mm_setr_ps(q.color.r, q.color.g, q.color.b, q.color.a);
+		const __m128 one = _mm_set1_ps(1.f);
+
+		if (q.texture == nullptr) {
+			//color only - same source for the whole span (texture color is 1 -> alpha texture term doesn't matter)
+			__m128 src = color;
+			float srcAlpha = _mm_cvtss_f32(_mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3)));
+
+			//opaque -> plain fill, 4 pixels per store
+			if (srcAlpha >= 1.f) {
+				uint32_t packed = Pack_SSE(src);
+				__m128i fill = _mm_set1_epi32(int(packed));
+				int x = xBegin;
+				for (; x + 4 <= xEnd; x += 4) {
+					_mm_storeu_si128((__m128i*)(row + x), fill);
+				}
+				for (; x < xEnd; x++) {
+					row[x] = packed;
+				}
+				return;
+			}
+
+			__m128 sa = _mm_set1_ps(srcAlpha);
+			__m128 srcPremul = _mm_mul_ps(src, sa);
+			__m128 invSa = _mm_sub_ps(one, sa);
+			for (int x = xBegin; x < xEnd; x++) {
+				row[x] = Pack_SSE(_mm_add_ps(srcPremul, _mm_mul_ps(Unpack_SSE(row[x]), invSa)));
+			}
+			return;
+		}
+
+		float cy = y + 0.5f;
+		float tcScaleX = q.texRect.z - q.texRect.x;
+		float tcScaleY = q.texRect.w - q.texRect.y;
+		const __m128 a = _mm_set1_ps(q.alphaTexture);
+		const __m128 invA = _mm_set1_ps(1.f - q.alphaTexture);
+
+		for (int x = xBegin; x < xEnd; x++) {
+			float cx = x + 0.5f;
+			float u = q.u0 + q.ux * cx + q.uy * cy;
+			float v = q.v0 + q.vx * cx + q.vy * cy;
+			__m128 t = Sample_SSE(*q.texture, q.texRect.x + tcScaleX * u, q.texRect.y + tcScaleY * v);
+
+			//alpha texture - (1, 1, 1, t.r)
+			__m128 tAlpha = _mm_setr_ps(1.f, 1.f, 1.f, _mm_cvtss_f32(t));
+			__m128 src = _mm_mul_ps(color, _mm_add_ps(_mm_mul_ps(invA, t), _mm_mul_ps(a, tAlpha)));
+
+			__m128 sa = _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 dst = Unpack_SSE(row[x]);
+			row[x] = Pack_SSE(_mm_add_ps(_mm_mul_ps(src, sa), _mm_mul_ps(dst, _mm_sub_ps(one, sa))));
+		}
+	}
+#endif
+
+	//===== shading path selection =====
+
+#ifdef BREAKOUT_X86
+	static ShadingPath shadingPath = ShadingPath::SSE;
+#else
+	static ShadingPath shadingPath = ShadingPath::Scalar;
+#endif
+
+	ShadingPath ActiveShadingPath() {
+		return shadingPath;
+	}
+
+	void SetShadingPath(ShadingPath path) {
+#ifdef BREAKOUT_X86
+		shadingPath = path;
+#else
+		shadingPath = ShadingPath::Scalar;
+#endif
+	}
+
+	const char* ShadingPathName(ShadingPath path) {
+		switch (path) {
+			case ShadingPath::Scalar:	return "Scalar";
+			case ShadingPath::SSE:		return "SSE";
+			default:					return "Unknown";
+		}
+	}
+
+	static void ShadeSpan(const QuadSetup& q, uint32_t* row, int y, int xBegin, int xEnd) {
+#ifdef BREAKOUT_X86
+		if (shadingPath == ShadingPath::SSE) {
+			ShadeSpan_SSE(q, row, y, xBegin, xEnd);
+			return;
+		}
+#endif
+		ShadeSpan_Scalar(q, row, y, xBegin, xEnd);
+	}
+
+	static inline glm::vec4 Sample(const Image& img, float s, float t) {
+#ifdef BREAKOUT_X86
+		if (shadingPath == ShadingPath::SSE) {
+			glm::vec4 result;
+			_mm_storeu_ps(&result.x, Sample_SSE(img, s, t));
+			return result;
+		}
+#endif
+		return Sample_Scalar(img, s, t);
+	}
+
+	//Narrows [lo, hi) to the pixel centers, where (a + k * cx) lies within [0, 1).
+	static void ClipInterval(float a, float k, float& lo, float& hi) {
+		if (k > 0.f) {
+			lo = std::max(lo, -a / k);
+			hi = std::min(hi, (1.f - a) / k);
+		}
+		else if (k < 0.f) {
+			lo = std::max(lo, (1.f - a) / k);
+			hi = std::min(hi, -a / k);
+		}
+		else if (a < 0.f || a >= 1.f) {
+			hi = lo;
+		}
+	}
+
+	//===== Rasterizer =====
+
+	Rasterizer::Rasterizer(int threadCount) : pool(threadCount) {}
+
+	Rasterizer::~Rasterizer() {}
+
+	void Rasterizer::Draw(Image& target, const Quad* quads, const Image* const* textures, int count) {
+		if (count <= 0 || target.width <= 0 || target.height <= 0)
+			return;
+
+		//transform into the pixel space (corner 0 = local origin, corners 2 & 1 = local x & y axes)
+		setups.resize(count);
+		glm::vec2 scale = glm::vec2(target.width, target.height) * 0.5f;
+		for (int i = 0; i < count; i++) {
+			const Quad& quad = quads[i];
+			QuadSetup& q = setups[i];
+
+			glm::vec2 c[4];
+			glm::vec2 bbMin = glm::vec2(1e30f);
+			glm::vec2 bbMax = glm::vec2(-1e30f);
+			for (int j = 0; j < 4; j++) {
+				c[j] = (quad.Corner(j) + 1.f) * scale;
+				bbMin = glm::min(bbMin, c[j]);
+				bbMax = glm::max(bbMax, c[j]);
+			}
+
+			glm::vec2 ex = c[2] - c[0];
+			glm::vec2 ey = c[1] - c[0];
+			float det = ex.x * ey.y - ex.y * ey.x;
+
+			q.x0 = std::max(int(floorf(std::max(bbMin.x, -1.f))), 0);
+			q.y0 = std::max(int(floorf(std::max(bbMin.y, -1.f))), 0);
+			q.x1 = std::min(int(ceilf(std::min(bbMax.x, float(target.width + 1)))), target.width);
+			q.y1 = std::min(int(ceilf(std::min(bbMax.y, float(target.height + 1)))), target.height);
+			q.skip = (fabsf(det) < 1e-12f) || (quad.color >> 24) == 0 || q.x0 >= q.x1 || q.y0 >= q.y1;
+			if (q.skip)
+				continue;
+
+			float invDet = 1.f / det;
+			q.ux = ey.y * invDet;
+			q.uy = -ey.x * invDet;
+			q.u0 = -(c[0].x * q.ux + c[0].y * q.uy);
+			q.vx = -ex.y * invDet;
+			q.vy = ex.x * invDet;
+			q.v0 = -(c[0].x * q.vx + c[0].y * q.vy);
+
+			q.texRect = quad.texRect;
+			q.color = Unpack(quad.color);
+			q.alphaTexture = quad.alphaTexture;
+			q.texture = (textures != nullptr) ? textures[i] : nullptr;
+		}
+
+		int bands = (target.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+		pool.ParallelFor(bands, [this, &target, count](int band, int) {
+			int bandBegin = band * BAND_HEIGHT;
+			int bandEnd = std::min(bandBegin + BAND_HEIGHT, target.height);
+
+			for (int i = 0; i < count; i++) {
+				const QuadSetup& q = setups[i];
+				if (q.skip || q.y1 <= bandBegin || q.y0 >= bandEnd)
+					continue;
+
+				for (int y = std::max(q.y0, bandBegin); y < std::min(q.y1, bandEnd); y++) {
+					//span of the pixel centers inside the quad
+					float cy = y + 0.5f;
+					float lo = float(q.x0) + 0.5f;
+					float hi = float(q.x1) + 0.5f;
+					ClipInterval(q.u0 + q.uy * cy, q.ux, lo, hi);
+					ClipInterval(q.v0 + q.vy * cy, q.vx, lo, hi);
+
+					int xBegin = std::max(int(ceilf(lo - 0.5f)), q.x0);
+					int xEnd = std::min(int(ceilf(hi - 0.5f)), q.x1);
+					if (xBegin < xEnd) {
+						ShadeSpan(q, target.pixels.data() + size_t(y) * target.width, y, xBegin, xEnd);
+					}
+				}
+			}
+		});
+	}
+
+	//postproc_shader.frag (drawn over a full-screen quad, blended)
+	void Rasterizer::Postprocess(const Image& source, Image& target, const PostprocParams& params) {
+		if (source.width <= 0 || source.height <= 0 || target.width <= 0 || target.height <= 0)
+			return;
+
+		static const float kernel[9] = {
+			1.f / 16, 2.f / 16, 1.f / 16,
+			2.f / 16, 4.f / 16, 2.f / 16,
+			1.f / 16, 2.f / 16, 1.f / 16
+		};
+		float o = params.offset;
+		const glm::vec2 offsets[9] = {
+			glm::vec2(-o,  o), glm::vec2(0.f,  o), glm::vec2(o,  o),
+			glm::vec2(-o, 0.f), glm::vec2(0.f, 0.f), glm::vec2(o, 0.f),
+			glm::vec2(-o, -o), glm::vec2(0.f, -o), glm::vec2(o, -o),
+		};
+
+		int bands = (target.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+		pool.ParallelFor(bands, [&](int band, int) {
+			int bandBegin = band * BAND_HEIGHT;
+			int bandEnd = std::min(bandBegin + BAND_HEIGHT, target.height);
+
+			for (int y = bandBegin; y < bandEnd; y++) {
+				uint32_t* row = target.pixels.data() + size_t(y) * target.width;
+				for (int x = 0; x < target.width; x++) {
+					//quad's texture coords are flipped vertically, the shader flips them back
+					glm::vec2 texCoords = glm::vec2((x + 0.5f) / target.width, 1.f - (y + 0.5f) / target.height);
+					glm::vec2 tc = glm::vec2(texCoords.x, 1.f - texCoords.y);
+
+					glm::vec4 color;
+					switch (params.effect) {
+						default:
+						case 0:		//none
+							color = Sample(source, tc.x, tc.y);
+							break;
+						case 1:		//blur + shake
+						case 2:		//drunk
+						{
+							glm::vec3 clr = glm::vec3(0.f);
+							for (int i = 0; i < 9; i++) {
+								glm::vec2 p = tc + params.shakeVec + offsets[i];
+								clr += glm::vec3(Sample(source, p.x, p.y)) * kernel[i];
+							}
+							color = glm::vec4(clr, 1.f);
+							break;
+						}
+						case 3:		//chaos - vertical offset
+							color = Sample(source, tc.x, tc.y + 0.3f);
+							break;
+						case 4:		//confuse - flip vertically and invert colors
+							color = glm::vec4(1.f - glm::vec3(Sample(source, texCoords.x, texCoords.y)), 1.f);
+							break;
+					}
+
+					glm::vec4 dst = Unpack(row[x]);
+					row[x] = Pack(color * color.a + dst * (1.f - color.a));
+				}
+			}
+		});
+	}
+
+}//namespace SoftRaster
@@ -1,10 +1,12 @@
 #include "breakout/sound.h"
 
 #include "breakout/log.h"
+#include "breakout/trace.h"
 
 namespace Sound {
 
 	void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+		TRACE_ZONE("Sound::DataCallback");
 		Device& dev = Device::Get();
 
 		std::lock_guard quad(dev.mutex);
@@ -68,6 +70,7 @@ namespace Sound {
 		//sound thread init
 		soundThread = std::thread(
 			[this]() {
+				TRACE_THREAD("Sound");
 				while (!terminating) {
 					//new decoder queued & not playing -> start the device
 					if (!playing && decoder != nullptr) {
@@ -76,6 +79,8 @@ namespace Sound {
 					}
 
 					if (playing) {
+						TRACE_ZONE("Sound::Playback");
+
 						//await device termination signal (on audio end)
 						ma_event_wait(&stopSignal);
 						//printf("Done playing\n");
@@ -67,6 +67,16 @@ glm::vec2 SubTexture::TexCoords(int i) const {
 	return texCoords[i];
 }
 
+uint64_t SubTexture::BindlessHandle() const {
+	SUBTEXTURE_VALIDATION_CHECK();
+	return atlas->BindlessHandle();
+}
+
+GLuint SubTexture::UnderlyingHandle() const {
+	SUBTEXTURE_VALIDATION_CHECK();
+	return atlas->Handle();
+}
+
 bool SubTexture::MatchingCoords(int x, int y) const {
 	return (x == coords.x && y == coords.y);
 }
@@ -192,6 +202,16 @@ void Texture::Resize(int width_, int height_) {
 	width = width_;
 	height = height_;
 
+	//resident handle makes the texture immutable -> replace it with a new texture object
+	//(no sync needed - already queued draws still see the old handle, deletion is deferred until the GPU is done with it)
+	if (bindlessHandle != 0) {
+		glMakeTextureHandleNonResidentARB(bindlessHandle);
+		bindlessHandle = 0;
+
+		glDeleteTextures(1, &handle);
+		glGenTextures(1, &handle);
+	}
+
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, handle);
 
@@ -219,6 +239,16 @@ void Texture::Bind(int slot) const {
 	glBindTexture(GL_TEXTURE_2D, handle);
 }
 
+uint64_t Texture::BindlessHandle() const {
+	TEXTURE_VALIDATION_CHECK();
+
+	if (bindlessHandle == 0) {
+		bindlessHandle = glGetTextureHandleARB(handle);
+		glMakeTextureHandleResidentARB(bindlessHandle);
+	}
+	return bindlessHandle;
+}
+
 glm::vec2 Texture::TexCoords(int i) const {
 	switch (i) {
 		case 0: return glm::vec2(0.f, 1.f);
@@ -233,6 +263,10 @@ void Texture::Release() noexcept {
 	if (handle != 0) {
 		LOG(LOG_DTOR, "[D] Texture '%s' (%d)\n", name.c_str(), handle);
 
+		if (bindlessHandle != 0) {
+			glMakeTextureHandleNonResidentARB(bindlessHandle);
+			bindlessHandle = 0;
+		}
 		glDeleteTextures(1, &handle);
 		handle = 0;
 	}
@@ -240,6 +274,7 @@ void Texture::Release() noexcept {
 
 void Texture::Move(Texture&& t) noexcept {
 	handle = t.handle;
+	bindlessHandle = t.bindlessHandle;
 	params = t.params;
 	width = t.width;
 	height = t.height;
@@ -248,6 +283,7 @@ void Texture::Move(Texture&& t) noexcept {
 	dtype = t.dtype;
 
 	t.handle = 0;
+	t.bindlessHandle = 0;
 }
 
 //===== AtlasTexture =====
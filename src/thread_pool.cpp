@@ -0,0 +1,79 @@
+#include "breakout/thread_pool.h"
+#include "breakout/log.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+	if (threadCount <= 0) {
+		threadCount = std::max(int(std::thread::hardware_concurrency()), 1);
+	}
+
+	threads.reserve(threadCount);
+	for (int i = 0; i < threadCount; i++) {
+		threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+
+	LOG(LOG_CTOR, "[C] ThreadPool (%d threads)\n", threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		terminating = true;
+	}
+	wakeup.notify_all();
+
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	LOG(LOG_DTOR, "[D] ThreadPool\n");
+}
+
+void ThreadPool::ParallelFor(int count, const JobType& job_) {
+	if (count <= 0)
+		return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &job_;
+	jobCount = count;
+	nextIdx = 0;
+	busyWorkers = int(threads.size());
+	generation++;
+	wakeup.notify_all();
+
+	done.wait(lock, [this]() { return busyWorkers == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker) {
+	int seenGeneration = 0;
+
+	while (true) {
+		const JobType* currJob;
+		int count;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [&]() { return terminating || generation != seenGeneration; });
+			if (terminating)
+				return;
+
+			seenGeneration = generation;
+			currJob = job;
+			count = jobCount;
+		}
+
+		//grab indices one by one, until there's nothing left
+		int idx;
+		while ((idx = nextIdx.fetch_add(1)) < count) {
+			(*currJob)(idx, worker);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0) {
+				done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#include "breakout/trace.h"
+
+#ifdef BREAKOUT_TRACE
+
+#include "breakout/log.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace Trace {
+
+	constexpr int ringCapacity = 1 << 16;		//zones per thread (power of 2)
+
+	struct Event {
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	//Single producer ring - only the owning thread writes, the exporter reads up to the published head.
+	struct ThreadRing {
+		Event events[ringCapacity];
+		std::atomic<uint64_t> head = 0;			//number of zones recorded so far
+		const char* name = nullptr;
+		int tid = 0;
+	};
+
+	//Rings outlive their threads (zones of the finished threads are still exported).
+	struct Registry {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadRing>> rings;
+
+		//timestamp -> ns conversion (calibrated against the OS clock between the startup & the export)
+		uint64_t startTicks = Now();
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	};
+
+	static Registry registry;
+	static thread_local ThreadRing* threadRing = nullptr;
+
+	//Registers the calling thread (locks only on the thread's first zone).
+	static ThreadRing* AcquireRing() {
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.rings.push_back(std::make_unique<ThreadRing>());
+		ThreadRing* ring = registry.rings.back().get();
+		ring->tid = int(registry.rings.size());
+		return ring;
+	}
+
+	void Record(const char* name, uint64_t begin, uint64_t end) {
+		ThreadRing* ring = threadRing;
+		if (ring == nullptr) {
+			ring = threadRing = AcquireRing();
+		}
+
+		uint64_t head = ring->head.load(std::memory_order_relaxed);
+		ring->events[head & (ringCapacity - 1)] = { name, begin, end };
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char* name) {
+		if (threadRing == nullptr) {
+			threadRing = AcquireRing();
+		}
+		threadRing->name = name;
+	}
+
+	bool Export(const char* filepath) {
+		FILE* f = fopen(filepath, "w");
+		if (f == nullptr) {
+			LOG(LOG_WARN, "Trace - failed to open '%s' for writing.\n", filepath);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry.startTime).count();
+		uint64_t elapsedTicks = Now() - registry.startTicks;
+		double tickToUs = (elapsedTicks > 0) ? elapsed_us / double(elapsedTicks) : 1e-3;
+
+		//timestamps relative to the earliest zone still in the rings
+		uint64_t origin = UINT64_MAX;
+		for (auto& ring : registry.rings) {
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t first = (head > ringCapacity) ? head - ringCapacity : 0;
+			if (head > first) {
+				origin = std::min(origin, ring->events[first & (ringCapacity - 1)].begin);
+			}
+		}
+
+		fprintf(f, "{\"traceEvents\":[\n");
+		bool firstEvent = true;
+		size_t count = 0;
+		for (auto& ring : registry.rings) {
+			if (ring->name != nullptr) {
+				fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", firstEvent ? "" : ",\n", ring->tid, ring->name);
+				firstEvent = false;
+			}
+
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t first = (head > ringCapacity) ? head - ringCapacity : 0;
+			for (uint64_t i = first; i < head; i++) {
+				const Event& e = ring->events[i & (ringCapacity - 1)];
+				fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", firstEvent ? "" : ",\n",
+					e.name, ring->tid, (e.begin - origin) * tickToUs, (e.end - e.begin) * tickToUs);
+				firstEvent = false;
+			}
+			count += size_t(head - first);
+		}
+		fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(f);
+
+		LOG(LOG_INFO, "Trace - %zu zones (%d threads) written into '%s'\n", count, int(registry.rings.size()), filepath);
+		return true;
+	}
+
+}//namespace Trace
+
+#endif
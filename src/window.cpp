@@ -2,11 +2,16 @@
 
 #include "breakout/log.h"
 #include "breakout/gl_debug.h"
+#include "breakout/trace.h"
+#include "breakout/framebuffer.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-bool Initialize(GLFWwindow*& window, int width, int height, const char* windowName);
+#include <stdio.h>
+#include <vector>
+
+bool Initialize(GLFWwindow*& window, int width, int height, const char* windowName, bool headless);
 
 //===== Window =====
 
@@ -21,15 +26,23 @@ Window& Window::Get() {
 	return instance;
 }
 
-void Window::Init(int width_, int height_, const char* windowName) {
+void Window::Init(int width_, int height_, const char* windowName, bool headless) {
 	width = width_;
 	height = height_;
-	if (!Initialize(window, width, height, windowName)) {
+	if (!Initialize(window, width, height, windowName, headless)) {
 		throw std::exception();
 	}
 
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, onResizeCallback);
+
+	if (headless) {
+		//no surface to draw into -> everything that targets the default framebuffer ends up in the offscreen one
+		backbuffer = std::make_shared<Framebuffer>(width, height, GL_RGBA8);
+		Framebuffer::SetBackbuffer(backbuffer.get());
+		Framebuffer::Unbind();
+		LOG(LOG_INFO, "Headless mode - rendering into an offscreen %dx%d framebuffer.\n", width, height);
+	}
 }
 
 bool Window::ShouldClose() const {
@@ -43,11 +56,51 @@ void Window::Close() {
 }
 
 void Window::SwapBuffers() {
+	Present();
+	PollEvents();
+}
+
+void Window::Present() {
 	WINDOW_VALIDITY_CHECK();
+	TRACE_ZONE("Window::SwapBuffers");
+	if (backbuffer != nullptr) {
+		//nothing to swap, just push the frame's commands to the driver
+		glFlush();
+		return;
+	}
 	glfwSwapBuffers(window);
+}
+
+void Window::PollEvents() {
+	WINDOW_VALIDITY_CHECK();
 	glfwPollEvents();
 }
 
+bool Window::SaveScreenshot(const char* filepath) {
+	WINDOW_VALIDITY_CHECK();
+
+	std::vector<uint8_t> pixels(size_t(width) * height * 3);
+	Framebuffer::Unbind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	FILE* f = fopen(filepath, "wb");
+	if (f == nullptr) {
+		LOG(LOG_WARN, "Window - failed to open '%s' for writing.\n", filepath);
+		return false;
+	}
+
+	//GL rows go bottom-up, PPM top-down
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	for (int y = height - 1; y >= 0; y--) {
+		fwrite(pixels.data() + size_t(y) * width * 3, 1, size_t(width) * 3, f);
+	}
+	fclose(f);
+
+	LOG(LOG_INFO, "Screenshot saved into '%s'\n", filepath);
+	return true;
+}
+
 Window::Window() {
 	LOG(LOG_CTOR, "[C] Window\n");
 }
@@ -58,7 +111,17 @@ Window::~Window() {
 
 //===================
 
-bool Initialize(GLFWwindow*& window, int width, int height, const char* windowName) {
+bool Initialize(GLFWwindow*& window, int width, int height, const char* windowName, bool headless) {
+	if (headless) {
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+		//no display connection needed
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+		LOG(LOG_ERROR, "GLFW - headless mode requires GLFW 3.4 or newer (null platform).\n");
+		return false;
+#endif
+	}
+
 	//glfw initialization
 	if (!glfwInit()) {
 		LOG(LOG_ERROR, "GLFW - Failed to initialize.\n");
@@ -73,8 +136,19 @@ bool Initialize(GLFWwindow*& window, int width, int height, const char* windowNa
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 #endif
 
+	if (headless) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
+
 	//context & window creation
 	window = glfwCreateWindow(width, height, windowName, NULL, NULL);
+	if (!window && headless) {
+		//no EGL (surfaceless) -> software context through OSMesa
+		LOG(LOG_INFO, "GLFW - EGL context creation failed, falling back to OSMesa.\n");
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		window = glfwCreateWindow(width, height, windowName, NULL, NULL);
+	}
 	if (!window) {
 		LOG(LOG_ERROR, "GLFW - Failed to create a window.\n");
 		glfwTerminate();
@@ -105,6 +179,15 @@ bool Initialize(GLFWwindow*& window, int width, int height, const char* windowNa
 	LOG(LOG_INFO, "OpenGL %s, %s (%s)\n", glGetString(GL_VERSION), glGetString(GL_RENDERER), glGetString(GL_VENDOR));
 	LOG(LOG_INFO, "GLSL %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 
+	//DSA & immutable storage are used all over the place (headless contexts can come up with a lower version, than requested)
+	if (!GLAD_GL_VERSION_4_5) {
+		LOG(LOG_ERROR, "OpenGL 4.5 is required, '%s' provides %s.\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = nullptr;
+		return false;
+	}
+
 	//viewport setup
 	glViewport(0, 0, width, height);
 
@@ -120,7 +203,6 @@ void Window::Resize(int newWidth, int newHeight) {
 	width = newWidth;
 	height = newHeight;
 
-	glViewport(0, 0, width, height);
 	if (ResizeCallback) {
 		ResizeCallback(width, height);
 	}
@@ -129,6 +211,10 @@ void Window::Resize(int newWidth, int newHeight) {
 void Window::Release() {
 	if (!released) {
 		released = true;
+		if (backbuffer != nullptr) {
+			Framebuffer::SetBackbuffer(nullptr);
+			backbuffer = nullptr;
+		}
 		glfwDestroyWindow(window);
 		glfwTerminate();
 		LOG(LOG_DTOR, "[D] Window\n");
@@ -0,0 +1,197 @@
+#include "breakout/log.h"
+
+#include "breakout/collision.h"
+
+#include <vector>
+#include <stdint.h>
+
+using namespace Game;
+using Collision::InstructionSet;
+
+//Cross-checks the SIMD ball-brick sweep kernels against the scalar one. Results (hit brick & time of impact) have to match exactly.
+
+struct SweepCase {
+	glm::vec2 pos;
+	glm::vec2 delta;
+	float radius;
+	glm::vec2 brickSize;
+	std::vector<glm::vec2> bricks;
+	int expected = -2;				//brick, that has to be hit (-1 = none, -2 = whatever the scalar kernel says)
+};
+
+struct SweepResult {
+	bool hit = false;
+	BrickHit info;
+};
+
+static uint32_t seed = 12345;
+
+static float Random(float min, float max) {
+	seed = seed * 1664525u + 1013904223u;
+	return min + (max - min) * float(seed >> 8) / float(1 << 24);
+}
+
+static std::vector<SweepCase> GenerateCases() {
+	std::vector<SweepCase> cases;
+
+	//randomized sweeps - bricks along the path, every 3rd on a grid around the end point
+	for (int test = 0; test < 2048; test++) {
+		SweepCase c;
+		c.pos = glm::vec2(Random(-1.f, 1.f), Random(-1.f, 1.f));
+		c.delta = glm::vec2(Random(-0.3f, 0.3f), Random(-0.3f, 0.3f));
+		if (test % 7 == 0)
+			c.delta.x = 0.f;		//axis aligned movement
+		if (test % 11 == 0)
+			c.delta.y = 0.f;
+		c.radius = Random(0.01f, 0.1f);
+		c.brickSize = glm::vec2(Random(0.005f, 0.1f), Random(0.005f, 0.1f));
+
+		//counts off the batch widths -> partially filled batches (padding lanes)
+		int n = 1 + test % 50;
+		for (int i = 0; i < n; i++) {
+			if (i % 3 == 0) {
+				c.bricks.push_back(c.pos + c.delta + c.brickSize * 2.f * glm::vec2(i % 5 - 2, 1));
+			}
+			else {
+				c.bricks.push_back(c.pos + c.delta * Random(0.f, 1.f) + glm::vec2(Random(-0.2f, 0.2f), Random(-0.2f, 0.2f)));
+			}
+		}
+		cases.push_back(c);
+	}
+
+	//ties - the same brick repeated at lane/batch boundaries (earlier candidate has to win)
+	const int tieSlots[][2] = { { 0, 1 }, { 3, 4 }, { 3, 19 }, { 7, 8 }, { 15, 16 }, { 0, 31 }, { 16, 47 }, { 31, 32 } };
+	for (const auto& slots : tieSlots) {
+		SweepCase c;
+		c.pos = glm::vec2(0.1f, 0.5f);
+		c.delta = glm::vec2(0.f, -0.4f);
+		c.radius = 0.02f;
+		c.brickSize = glm::vec2(0.1f, 0.05f);
+		for (int i = 0; i <= slots[1]; i++) {
+			c.bricks.push_back(glm::vec2(-0.8f + 0.01f * i, 0.9f));		//out of the way
+		}
+		c.bricks[slots[0]] = c.bricks[slots[1]] = glm::vec2(0.1f, 0.2f);
+		c.expected = slots[0];
+		cases.push_back(c);
+	}
+
+	//ties - mirrored bricks, hit by their corners at the same time
+	for (int i = 1; i <= 20; i++) {
+		SweepCase c;
+		c.pos = glm::vec2(0.f, 0.5f);
+		c.delta = glm::vec2(0.f, -0.5f);
+		c.radius = 0.03f;
+		c.brickSize = glm::vec2(0.1f, 0.05f);
+		float x = 0.1f + 0.001f * i;
+		for (int k = 0; k < i; k++) {
+			c.bricks.push_back(glm::vec2(0.5f + 0.01f * k, -0.5f));		//misses
+		}
+		c.bricks.push_back(glm::vec2(-x, 0.1f));
+		c.bricks.push_back(glm::vec2(x, 0.1f));
+		c.expected = i;
+		cases.push_back(c);
+	}
+
+	//ball already overlapping (t = 0), only padding lanes next to the brick
+	for (int i = 0; i < 16; i++) {
+		SweepCase c;
+		c.pos = glm::vec2(0.f);
+		c.delta = glm::vec2(0.1f, 0.05f);
+		c.radius = 0.05f;
+		c.brickSize = glm::vec2(0.1f, 0.05f);
+		for (int k = 0; k < i; k++) {
+			c.bricks.push_back(glm::vec2(-0.9f, 0.9f - 0.1f * k));		//misses
+		}
+		c.bricks.push_back(glm::vec2(0.02f, 0.01f));
+		c.expected = i;
+		cases.push_back(c);
+	}
+
+	//no hit at all (padding lanes must never report a hit)
+	for (int i = 1; i <= 40; i++) {
+		SweepCase c;
+		c.pos = glm::vec2(0.f);
+		c.delta = glm::vec2(0.f, 0.1f);
+		c.radius = 0.02f;
+		c.brickSize = glm::vec2(0.05f);
+		for (int k = 0; k < i; k++) {
+			c.bricks.push_back(glm::vec2(0.5f, -0.5f + 0.02f * k));
+		}
+		c.expected = -1;
+		cases.push_back(c);
+	}
+
+	return cases;
+}
+
+static std::vector<SweepResult> RunCases(const std::vector<SweepCase>& cases) {
+	std::vector<SweepResult> results;
+
+	//candidates are reused (like in the simulation) -> stale data past the padding must not matter
+	BrickCandidates candidates;
+	for (const SweepCase& c : cases) {
+		candidates.Clear();
+		for (int i = 0; i < int(c.bricks.size()); i++) {
+			candidates.Add(i, c.bricks[i]);
+		}
+
+		SweepResult r;
+		r.hit = Collision::Ball_BricksSweep(c.pos, c.delta, c.radius, c.brickSize, candidates, r.info);
+		results.push_back(r);
+	}
+	return results;
+}
+
+//Checks the hand-made cases with a known outcome.
+static int CheckExpected(const char* setName, const std::vector<SweepCase>& cases, const std::vector<SweepResult>& results) {
+	int errors = 0;
+	for (int i = 0; i < int(cases.size()); i++) {
+		int brick = results[i].hit ? results[i].info.brickIdx : -1;
+		if (cases[i].expected != -2 && brick != cases[i].expected) {
+			LOG(LOG_ERROR, "%s: sweep %d - hit brick %d, expected %d\n", setName, i, brick, cases[i].expected);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+int main() {
+	std::vector<SweepCase> cases = GenerateCases();
+
+	Collision::SetInstructionSet(InstructionSet::Scalar);
+	std::vector<SweepResult> reference = RunCases(cases);
+
+	int hits = 0;
+	for (const SweepResult& r : reference) {
+		hits += r.hit;
+	}
+	LOG(LOG_INFO, "%d sweeps, %d hits (scalar reference)\n", int(cases.size()), hits);
+
+	int failed = (CheckExpected("Scalar", cases, reference) > 0);
+	for (InstructionSet set : { InstructionSet::SSE, InstructionSet::AVX2, InstructionSet::AVX512 }) {
+		Collision::SetInstructionSet(set);
+		if (Collision::ActiveInstructionSet() != set) {
+			LOG(LOG_INFO, "%s: not supported by the CPU, skipped\n", Collision::InstructionSetName(set));
+			continue;
+		}
+
+		std::vector<SweepResult> results = RunCases(cases);
+		int mismatches = CheckExpected(Collision::InstructionSetName(set), cases, results);
+		for (int i = 0; i < int(cases.size()); i++) {
+			const SweepResult& a = reference[i];
+			const SweepResult& b = results[i];
+			if (a.hit != b.hit || (a.hit && (a.info.brickIdx != b.info.brickIdx || a.info.t != b.info.t))) {
+				if (mismatches < 10) {
+					LOG(LOG_ERROR, "%s: sweep %d - brick %d, t = %.9g (scalar: brick %d, t = %.9g)\n", Collision::InstructionSetName(set), i,
+						b.hit ? b.info.brickIdx : -1, b.info.t, a.hit ? a.info.brickIdx : -1, a.info.t);
+				}
+				mismatches++;
+			}
+		}
+
+		LOG(mismatches ? LOG_ERROR : LOG_INFO, "%s: %d mismatches\n", Collision::InstructionSetName(set), mismatches);
+		failed += (mismatches > 0);
+	}
+
+	return failed ? 1 : 0;
+}
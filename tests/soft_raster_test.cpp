@@ -0,0 +1,170 @@
+#include "breakout/log.h"
+
+#include "breakout/soft_raster.h"
+#include "breakout/renderer.h"
+
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+using SoftRaster::Image;
+using SoftRaster::ShadingPath;
+
+//Cross-checks the software rasterizer's SSE shading against the scalar reference. Pixels have to match exactly.
+
+constexpr int targetWidth = 333;		//odd sizes -> partial bands & spans, that aren't multiples of 4
+constexpr int targetHeight = 217;
+
+static uint32_t seed = 12345;
+
+static uint32_t RandomBits() {
+	seed = seed * 1664525u + 1013904223u;
+	return seed;
+}
+
+static float Random(float min, float max) {
+	return min + (max - min) * float(RandomBits() >> 8) / float(1 << 24);
+}
+
+static uint32_t RandomColor(bool opaque) {
+	return opaque ? (RandomBits() | 0xFF000000u) : RandomBits();
+}
+
+static Image NoiseImage(int width, int height, bool repeat) {
+	Image img;
+	img.Resize(width, height);
+	img.repeat = repeat;
+	for (uint32_t& p : img.pixels) {
+		p = RandomBits();
+	}
+	return img;
+}
+
+struct DrawCase {
+	const char* name;
+	std::vector<Quad> quads;
+	std::vector<const Image*> textures;
+};
+
+static Quad RandomQuad(bool rotated, uint32_t color) {
+	Quad q;
+	q.center = glm::vec3(Random(-1.2f, 1.2f), Random(-1.2f, 1.2f), 0.f);
+	q.halfSize = glm::vec2(Random(0.005f, 0.5f), Random(0.005f, 0.5f));
+	q.angle_rad = rotated ? Random(-3.14f, 3.14f) : 0.f;
+	q.texRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+	q.textureHandle = 0;
+	q.color = color;
+	return q;
+}
+
+static std::vector<DrawCase> GenerateCases(const Image& texture, const Image& pattern, const Image& glyphs) {
+	std::vector<DrawCase> cases;
+
+	DrawCase opaque = { "opaque colors" };
+	DrawCase translucent = { "translucent colors" };
+	DrawCase textured = { "textured" };
+	DrawCase rotated = { "rotated & textured" };
+	DrawCase repeated = { "repeated texture" };
+	DrawCase text = { "alpha texture (text)" };
+	for (int i = 0; i < 200; i++) {
+		opaque.quads.push_back(RandomQuad(i % 2, RandomColor(true)));
+		opaque.textures.push_back(nullptr);
+
+		translucent.quads.push_back(RandomQuad(i % 2, RandomColor(false)));
+		translucent.textures.push_back(nullptr);
+
+		Quad q = RandomQuad(false, (i % 3) ? 0xFFFFFFFFu : RandomColor(false));
+		q.texRect = glm::vec4(Random(0.f, 0.5f), Random(0.f, 0.5f), Random(0.5f, 1.f), Random(0.5f, 1.f));
+		textured.quads.push_back(q);
+		textured.textures.push_back(&texture);
+
+		q.angle_rad = Random(-3.14f, 3.14f);
+		rotated.quads.push_back(q);
+		rotated.textures.push_back(&texture);
+
+		q = RandomQuad(i % 2, RandomColor(false));
+		q.texRect = glm::vec4(Random(-2.f, 0.f), Random(-2.f, 0.f), Random(1.f, 3.f), Random(1.f, 3.f));
+		repeated.quads.push_back(q);
+		repeated.textures.push_back(&pattern);
+
+		//glyph sized quads, sampling a sub-rect of the atlas (flipped vertically, like Quad's text constructor)
+		q = RandomQuad(false, RandomColor(i % 2));
+		q.halfSize = glm::vec2(Random(0.005f, 0.05f), Random(0.01f, 0.06f));
+		float x = Random(0.f, 0.9f);
+		q.texRect = glm::vec4(x, 1.f, x + 0.1f, 0.f);
+		q.alphaTexture = 1.f;
+		text.quads.push_back(q);
+		text.textures.push_back(&glyphs);
+	}
+
+	cases.push_back(opaque);
+	cases.push_back(translucent);
+	cases.push_back(textured);
+	cases.push_back(rotated);
+	cases.push_back(repeated);
+	cases.push_back(text);
+	return cases;
+}
+
+static int Compare(const char* name, const Image& reference, const Image& result) {
+	int mismatches = 0;
+	for (size_t i = 0; i < reference.pixels.size(); i++) {
+		if (reference.pixels[i] != result.pixels[i]) {
+			if (mismatches < 10) {
+				LOG(LOG_ERROR, "%s: pixel (%d, %d) - %08x (scalar: %08x)\n", name, int(i % reference.width), int(i / reference.width), result.pixels[i], reference.pixels[i]);
+			}
+			mismatches++;
+		}
+	}
+	LOG(mismatches ? LOG_ERROR : LOG_INFO, "%s: %d mismatches\n", name, mismatches);
+	return mismatches;
+}
+
+int main() {
+	SoftRaster::SetShadingPath(ShadingPath::SSE);
+	if (SoftRaster::ActiveShadingPath() != ShadingPath::SSE) {
+		LOG(LOG_INFO, "SSE: not available, nothing to compare\n");
+		return 0;
+	}
+
+	Image texture = NoiseImage(64, 48, false);
+	Image pattern = NoiseImage(7, 5, true);
+	Image glyphs = NoiseImage(256, 32, false);
+	Image background = NoiseImage(targetWidth, targetHeight, false);
+
+	SoftRaster::Rasterizer raster(4);
+	int failed = 0;
+
+	for (const DrawCase& c : GenerateCases(texture, pattern, glyphs)) {
+		Image images[2];
+		for (ShadingPath path : { ShadingPath::Scalar, ShadingPath::SSE }) {
+			SoftRaster::SetShadingPath(path);
+			Image& img = images[int(path)];
+			img = background;
+			raster.Draw(img, c.quads.data(), c.textures.data(), int(c.quads.size()));
+		}
+		failed += (Compare(c.name, images[0], images[1]) > 0);
+	}
+
+	//postprocessing effects, upscaled from a smaller source (like with the dynamic resolution)
+	Image source = NoiseImage(targetWidth / 2, targetHeight / 2, false);
+	for (int effect = 0; effect < 5; effect++) {
+		SoftRaster::PostprocParams params;
+		params.shakeVec = glm::vec2(0.013f, -0.007f);
+		params.effect = effect;
+
+		Image images[2];
+		for (ShadingPath path : { ShadingPath::Scalar, ShadingPath::SSE }) {
+			SoftRaster::SetShadingPath(path);
+			Image& img = images[int(path)];
+			img = background;
+			raster.Postprocess(source, img, params);
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "postprocess (effect %d)", effect);
+		failed += (Compare(name, images[0], images[1]) > 0);
+	}
+
+	return failed ? 1 : 0;
+}